@@ -28,6 +28,19 @@
 #
 ******************************************************************************/
 #include "DEV_Config.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+
+#if DEV_SPI_USE_HW
+#include "driver/spi_master.h"
+#include "esp_heap_caps.h"
+#if __has_include("esp_memory_utils.h")
+#include "esp_memory_utils.h"      // esp_ptr_dma_capable (ESP-IDF 5.x)
+#else
+#include "soc/soc_memory_layout.h" // esp_ptr_dma_capable (ESP-IDF 4.x)
+#endif
+#endif
 
 void GPIO_Config(void)
 {
@@ -90,27 +103,154 @@ UBYTE DEV_Module_Init(void)
 
 /******************************************************************************
 function:
-			SPI读写
+			SPI读写（软件模拟，DEV_SPI_USE_HW=0 时使用，也是硬件初始化失败时的兜底）
 ******************************************************************************/
-void DEV_SPI_WriteByte(UBYTE data)
+static void DEV_SPI_BitBang(const UBYTE *pData, UDOUBLE len)
 {
-    digitalWrite(EPD_CS_PIN, GPIO_PIN_RESET);
+    for (UDOUBLE i = 0; i < len; i++) {
+        UBYTE data = pData[i];
+        for (int j = 0; j < 8; j++) {
+            if ((data & 0x80) == 0) digitalWrite(EPD_MOSI_PIN, GPIO_PIN_RESET); 
+            else                    digitalWrite(EPD_MOSI_PIN, GPIO_PIN_SET);
+            data <<= 1;
+            digitalWrite(EPD_SCK_PIN, GPIO_PIN_SET);     
+            digitalWrite(EPD_SCK_PIN, GPIO_PIN_RESET);
+        }
+    }
+}
 
-    for (int i = 0; i < 8; i++)
-    {
-        if ((data & 0x80) == 0) digitalWrite(EPD_MOSI_PIN, GPIO_PIN_RESET); 
-        else                    digitalWrite(EPD_MOSI_PIN, GPIO_PIN_SET);
+#if DEV_SPI_USE_HW
+/******************************************************************************
+function:
+			SPI读写（硬件GPSPI2 + DMA）
+Info:
+    首次发送时才初始化总线：setup()中的 pinMode(SCK/MOSI) 会把引脚切回普通GPIO，
+    延迟到第一次传输可以保证引脚最终路由到SPI外设。
+    CS不交给驱动（spics_io_num=-1），EPD_7in3e.cpp 中手动拉CS/DC的时序保持不变。
+******************************************************************************/
+static spi_device_handle_t DEV_SPI_Handle = NULL;
+static UBYTE *DEV_SPI_Bounce = NULL;   // DMA中转缓冲区（源数据不在DMA可访问内存时使用）
+static bool DEV_SPI_HwFailed = false;  // 初始化失败后退回软件模拟，不再重试
+static spi_transaction_t DEV_SPI_AsyncTrans;     // 异步发送中的事务（同一时间最多一个）
+static bool DEV_SPI_AsyncPending = false;
+static volatile int64_t DEV_SPI_DoneUs = 0;      // 最近一次事务完成的时间戳（中断中记录）
 
-        data <<= 1;
-        digitalWrite(EPD_SCK_PIN, GPIO_PIN_SET);     
-        digitalWrite(EPD_SCK_PIN, GPIO_PIN_RESET);
+static void IRAM_ATTR DEV_SPI_PostCallback(spi_transaction_t *t)
+{
+    DEV_SPI_DoneUs = esp_timer_get_time();
+}
+
+static bool DEV_SPI_HW_Begin(void)
+{
+    if (DEV_SPI_Handle != NULL) return true;
+    if (DEV_SPI_HwFailed) return false;
+
+    spi_bus_config_t buscfg = {};
+    buscfg.mosi_io_num = EPD_MOSI_PIN;
+    buscfg.miso_io_num = -1;
+    buscfg.sclk_io_num = EPD_SCK_PIN;
+    buscfg.quadwp_io_num = -1;
+    buscfg.quadhd_io_num = -1;
+    buscfg.max_transfer_sz = DEV_SPI_DMA_CHUNK;
+
+    spi_device_interface_config_t devcfg = {};
+    devcfg.clock_speed_hz = DEV_SPI_CLOCK_HZ;
+    devcfg.mode = 0;                // CPOL=0, CPHA=0，与软件模拟一致
+    devcfg.spics_io_num = -1;       // CS由GPIO控制
+    devcfg.queue_size = 2;
+    devcfg.post_cb = DEV_SPI_PostCallback;
+
+    esp_err_t err = spi_bus_initialize(DEV_SPI_HOST, &buscfg, SPI_DMA_CH_AUTO);
+    if (err == ESP_OK) {
+        err = spi_bus_add_device(DEV_SPI_HOST, &devcfg, &DEV_SPI_Handle);
+        if (err != ESP_OK) spi_bus_free(DEV_SPI_HOST);
+    }
+    if (err == ESP_OK && DEV_SPI_Bounce == NULL) {
+        DEV_SPI_Bounce = (UBYTE *)heap_caps_malloc(DEV_SPI_DMA_CHUNK, MALLOC_CAP_DMA);
+    }
+    if (err != ESP_OK || DEV_SPI_Bounce == NULL) {
+        Serial.printf("⚠️  硬件SPI初始化失败(%d)，退回软件模拟\n", (int)err);
+        if (DEV_SPI_Handle != NULL) {
+            spi_bus_remove_device(DEV_SPI_Handle);
+            spi_bus_free(DEV_SPI_HOST);
+            DEV_SPI_Handle = NULL;
+        }
+        pinMode(EPD_SCK_PIN, OUTPUT);
+        pinMode(EPD_MOSI_PIN, OUTPUT);
+        digitalWrite(EPD_SCK_PIN, LOW);
+        DEV_SPI_HwFailed = true;
+        return false;
     }
 
+    // 总线上只有墨水屏一个设备：长期占用总线，减少每次polling传输的开销
+    spi_device_acquire_bus(DEV_SPI_Handle, portMAX_DELAY);
+    return true;
+}
+
+static void DEV_SPI_HW_End(void)
+{
+    if (DEV_SPI_Handle == NULL) return;
+    spi_device_release_bus(DEV_SPI_Handle);
+    spi_bus_remove_device(DEV_SPI_Handle);
+    spi_bus_free(DEV_SPI_HOST);
+    DEV_SPI_Handle = NULL;
+    pinMode(EPD_SCK_PIN, OUTPUT);
+    pinMode(EPD_MOSI_PIN, OUTPUT);
+    digitalWrite(EPD_SCK_PIN, LOW);
+}
+
+static void DEV_SPI_HW_Transmit(const UBYTE *pData, UDOUBLE len)
+{
+    while (len > 0) {
+        UDOUBLE n = (len > DEV_SPI_DMA_CHUNK) ? DEV_SPI_DMA_CHUNK : len;
+        spi_transaction_t t = {};
+        t.length = n * 8;
+
+        if (n <= 4) {
+            // 短数据直接放进事务描述符，不走DMA缓冲区
+            t.flags = SPI_TRANS_USE_TXDATA;
+            memcpy(t.tx_data, pData, n);
+            spi_device_polling_transmit(DEV_SPI_Handle, &t);
+        } else {
+            if (esp_ptr_dma_capable(pData)) {
+                t.tx_buffer = pData;
+            } else {
+                memcpy(DEV_SPI_Bounce, pData, n);
+                t.tx_buffer = DEV_SPI_Bounce;
+            }
+            spi_device_transmit(DEV_SPI_Handle, &t);
+        }
+
+        pData += n;
+        len -= n;
+    }
+}
+#endif
+
+static void DEV_SPI_Transmit(const UBYTE *pData, UDOUBLE len)
+{
+#if DEV_SPI_USE_HW
+    if (DEV_SPI_HW_Begin()) {
+        DEV_SPI_HW_Transmit(pData, len);
+        return;
+    }
+#endif
+    DEV_SPI_BitBang(pData, len);
+}
+
+void DEV_SPI_WriteByte(UBYTE data)
+{
+    digitalWrite(EPD_CS_PIN, GPIO_PIN_RESET);
+    DEV_SPI_Transmit(&data, 1);
     digitalWrite(EPD_CS_PIN, GPIO_PIN_SET);
 }
 
 UBYTE DEV_SPI_ReadByte()
 {
+#if DEV_SPI_USE_HW
+    // 读取需要把MOSI切成输入，先释放硬件总线，下次写入时自动重新初始化
+    DEV_SPI_HW_End();
+#endif
     UBYTE j=0xff;
     GPIO_Mode(EPD_MOSI_PIN, 0);
     digitalWrite(EPD_CS_PIN, GPIO_PIN_RESET);
@@ -132,19 +272,172 @@ void DEV_SPI_Write_nByte(UBYTE *pData, UDOUBLE len)
 {
     // 优化：批量传输时保持CS低，减少切换次数
     digitalWrite(EPD_CS_PIN, GPIO_PIN_RESET);  // CS低，开始传输
-    
-    for (int i = 0; i < len; i++) {
-        UBYTE data = pData[i];
-        for (int j = 0; j < 8; j++) {
-            if ((data & 0x80) == 0) digitalWrite(EPD_MOSI_PIN, GPIO_PIN_RESET); 
-            else                    digitalWrite(EPD_MOSI_PIN, GPIO_PIN_SET);
-            data <<= 1;
-            digitalWrite(EPD_SCK_PIN, GPIO_PIN_SET);     
-            digitalWrite(EPD_SCK_PIN, GPIO_PIN_RESET);
+    DEV_SPI_Transmit(pData, len);
+    digitalWrite(EPD_CS_PIN, GPIO_PIN_SET);  // CS高，结束传输
+}
+
+/******************************************************************************
+function:	在一次CS低电平内发送命令及其参数（DC先低后高）
+parameter:
+    cmd   : 命令字节
+    pData : 参数，可以放在Flash中（len为0时可为NULL）
+    len   : 参数字节数
+******************************************************************************/
+void DEV_SPI_WriteCommand(UBYTE cmd, const UBYTE *pData, UDOUBLE len)
+{
+    digitalWrite(EPD_DC_PIN, GPIO_PIN_RESET);  // 命令
+    digitalWrite(EPD_CS_PIN, GPIO_PIN_RESET);
+    DEV_SPI_Transmit(&cmd, 1);
+    if (len > 0) {
+        digitalWrite(EPD_DC_PIN, GPIO_PIN_SET);  // 参数
+        DEV_SPI_Transmit(pData, len);
+    }
+    digitalWrite(EPD_CS_PIN, GPIO_PIN_SET);
+}
+
+/******************************************************************************
+function:	异步批量发送：拉低CS并启动DMA后立即返回，CPU可以去准备下一批数据
+parameter:
+    pData : 待发送数据，在 DEV_SPI_Write_nByte_Wait() 返回前不能修改或释放
+    len   : 字节数
+Info:
+    必须与 DEV_SPI_Write_nByte_Wait() 成对调用，中间不能再调用其它SPI函数。
+    超过 DEV_SPI_DMA_CHUNK 的数据或软件模拟后端会退化为同步发送。
+******************************************************************************/
+void DEV_SPI_Write_nByte_Start(UBYTE *pData, UDOUBLE len)
+{
+    digitalWrite(EPD_CS_PIN, GPIO_PIN_RESET);
+#if DEV_SPI_USE_HW
+    if (len > 4 && len <= DEV_SPI_DMA_CHUNK && DEV_SPI_HW_Begin()) {
+        memset(&DEV_SPI_AsyncTrans, 0, sizeof(DEV_SPI_AsyncTrans));
+        DEV_SPI_AsyncTrans.length = len * 8;
+        if (esp_ptr_dma_capable(pData)) {
+            DEV_SPI_AsyncTrans.tx_buffer = pData;
+        } else {
+            memcpy(DEV_SPI_Bounce, pData, len);
+            DEV_SPI_AsyncTrans.tx_buffer = DEV_SPI_Bounce;
+        }
+        if (spi_device_queue_trans(DEV_SPI_Handle, &DEV_SPI_AsyncTrans, portMAX_DELAY) == ESP_OK) {
+            DEV_SPI_AsyncPending = true;
+            return;
         }
     }
-    
-    digitalWrite(EPD_CS_PIN, GPIO_PIN_SET);  // CS高，结束传输
+#endif
+    DEV_SPI_Transmit(pData, len);
+#if DEV_SPI_USE_HW
+    DEV_SPI_DoneUs = esp_timer_get_time();
+#endif
+}
+
+/******************************************************************************
+function:	等待异步批量发送完成并拉高CS
+return:     发送实际完成时刻（esp_timer微秒），用于统计SPI空闲时间
+******************************************************************************/
+int64_t DEV_SPI_Write_nByte_Wait(void)
+{
+    int64_t doneUs = esp_timer_get_time();
+#if DEV_SPI_USE_HW
+    if (DEV_SPI_AsyncPending) {
+        spi_transaction_t *done = NULL;
+        spi_device_get_trans_result(DEV_SPI_Handle, &done, portMAX_DELAY);
+        DEV_SPI_AsyncPending = false;
+    }
+    doneUs = DEV_SPI_DoneUs;
+#endif
+    digitalWrite(EPD_CS_PIN, GPIO_PIN_SET);
+    return doneUs;
+}
+
+/******************************************************************************
+function:	等待BUSY引脚变为指定电平
+parameter:
+    level      : 期望电平（本屏 1=空闲）
+    timeout_ms : 超时时间
+return:     true=已到达期望电平，false=超时
+Info:
+    先轮询 DEV_BUSY_SPIN_US，之后以BUSY电平作为GPIO唤醒源进入light-sleep，
+    超时同时作为定时唤醒源。light-sleep期间WiFi连接不保持，
+    所以只应在不再需要网络的刷新阶段调用。
+******************************************************************************/
+#if !DEV_BUSY_LIGHT_SLEEP
+static volatile TaskHandle_t DEV_BusyWaiter = NULL;
+
+static void IRAM_ATTR DEV_BusyIsr(void)
+{
+    BaseType_t woken = pdFALSE;
+    if (DEV_BusyWaiter != NULL) {
+        vTaskNotifyGiveFromISR(DEV_BusyWaiter, &woken);
+    }
+    if (woken) portYIELD_FROM_ISR();
+}
+#endif
+
+bool DEV_Wait_Busy(UBYTE level, UDOUBLE timeout_ms)
+{
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + (int64_t)timeout_ms * 1000;
+
+    while (digitalRead(EPD_BUSY_PIN) != level) {
+        int64_t now = esp_timer_get_time();
+        if (now >= deadline) {
+            return false;
+        }
+        if (now - start < DEV_BUSY_SPIN_US) {
+            delayMicroseconds(100);
+            continue;
+        }
+
+#if DEV_BUSY_LIGHT_SLEEP
+        gpio_wakeup_enable((gpio_num_t)EPD_BUSY_PIN, level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+        esp_sleep_enable_timer_wakeup((uint64_t)(deadline - now));
+        Serial.flush();  // light-sleep期间UART停止，先把日志发完
+
+        esp_err_t err = esp_light_sleep_start();
+
+        gpio_wakeup_disable((gpio_num_t)EPD_BUSY_PIN);
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+        if (err != ESP_OK) {
+            delay(10);  // 无法进入light-sleep时退化为低频轮询
+        }
+#else
+        DEV_BusyWaiter = xTaskGetCurrentTaskHandle();
+        attachInterrupt(digitalPinToInterrupt(EPD_BUSY_PIN), DEV_BusyIsr, level ? RISING : FALLING);
+        // 挂中断前后电平可能已经变化，重新确认后再阻塞
+        if (digitalRead(EPD_BUSY_PIN) != level) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((deadline - now) / 1000 + 1));
+        }
+        detachInterrupt(digitalPinToInterrupt(EPD_BUSY_PIN));
+        DEV_BusyWaiter = NULL;
+#endif
+    }
+    return true;
+}
+
+/******************************************************************************
+function:	分配可直接用于DMA传输的缓冲区（软件模拟时等同于malloc）
+parameter:
+    size : 字节数
+Info:
+    批量发送的数据放在这里可以省掉一次到中转缓冲区的拷贝
+******************************************************************************/
+void *DEV_SPI_DmaMalloc(UDOUBLE size)
+{
+#if DEV_SPI_USE_HW
+    return heap_caps_malloc(size, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+#else
+    return malloc(size);
+#endif
+}
+
+void DEV_SPI_DmaFree(void *p)
+{
+#if DEV_SPI_USE_HW
+    heap_caps_free(p);
+#else
+    free(p);
+#endif
 }
 
 void DEV_Module_Exit(void)
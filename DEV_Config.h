@@ -57,6 +57,21 @@
 #define GPIO_PIN_SET   1
 #define GPIO_PIN_RESET 0
 
+// SPI后端选择：1=硬件GPSPI2 + DMA（ESP-IDF spi_master），0=软件模拟（bit-bang）
+// 硬件后端沿用上面的引脚（SCK=2, MOSI=3），CS仍由GPIO控制，调用方时序不变
+#define DEV_SPI_USE_HW 1
+#if DEV_SPI_USE_HW
+    #define DEV_SPI_HOST      SPI2_HOST
+    #define DEV_SPI_CLOCK_HZ  (10 * 1000 * 1000)  // 10MHz（控制器写入上限约20MHz）
+    #define DEV_SPI_DMA_CHUNK 4092                // 单次DMA传输的最大字节数
+#endif
+
+// BUSY等待：1=BUSY引脚GPIO唤醒 + light-sleep（E6刷新几十秒内CPU不空转），
+//           0=GPIO中断 + 任务阻塞（不进light-sleep，便于调试串口输出）
+#define DEV_BUSY_LIGHT_SLEEP 1
+#define DEV_BUSY_TIMEOUT_MS  60000  // 单次BUSY等待超时（ms），E6整屏刷新约需20~30s
+#define DEV_BUSY_SPIN_US     2000   // 先短暂轮询，短忙信号不值得进出一次light-sleep
+
 // GPIO读写
 #define DEV_Digital_Write(_pin, _value) digitalWrite(_pin, _value == 0? LOW:HIGH)
 #define DEV_Digital_Read(_pin) digitalRead(_pin)
@@ -70,6 +85,12 @@ void GPIO_Mode(UWORD GPIO_Pin, UWORD Mode);
 void DEV_SPI_WriteByte(UBYTE data);
 UBYTE DEV_SPI_ReadByte();
 void DEV_SPI_Write_nByte(UBYTE *pData, UDOUBLE len);
+void DEV_SPI_WriteCommand(UBYTE cmd, const UBYTE *pData, UDOUBLE len);
+void DEV_SPI_Write_nByte_Start(UBYTE *pData, UDOUBLE len);
+int64_t DEV_SPI_Write_nByte_Wait(void);
+bool DEV_Wait_Busy(UBYTE level, UDOUBLE timeout_ms);
+void *DEV_SPI_DmaMalloc(UDOUBLE size);
+void DEV_SPI_DmaFree(void *p);
 void DEV_Module_Exit(void);
 
 #endif
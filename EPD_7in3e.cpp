@@ -73,40 +73,118 @@ static void EPD_7IN3E_SendData(UBYTE Data)
 /******************************************************************************
 function :  等待busy_pin变为高电平
 parameter:
+return   :  超时（DEV_BUSY_TIMEOUT_MS 内BUSY一直为低）返回 false
 ******************************************************************************/
-static void EPD_7IN3E_ReadBusyH(void)
+static bool EPD_7IN3E_ReadBusyH(void)
 {
     Debug("e-Paper busy H\r\n");
-    while(!DEV_Digital_Read(EPD_BUSY_PIN)) {      // 低电平：忙碌，高电平：空闲
-        DEV_Delay_ms(1);
+    // 低电平：忙碌，高电平：空闲；等待期间CPU进入light-sleep，由BUSY上升沿唤醒
+    if (!DEV_Wait_Busy(1, DEV_BUSY_TIMEOUT_MS)) {
+        Debug("e-Paper busy H timeout\r\n");
+        return false;
     }
     Debug("e-Paper busy H release\r\n");
+    return true;
 }
 
 /******************************************************************************
-function :  开启显示
+function :  命令表：每一项是一条命令及其参数，执行后可选等待BUSY和延时
+            表放在Flash中，由 EPD_7IN3E_RunSequence 统一执行，
+            每条命令连同参数在一次CS低电平内发完
+******************************************************************************/
+#define EPD_7IN3E_SEQ_WAIT_BUSY  0x01   // 执行后等待BUSY变高
+
+typedef struct {
+    UBYTE cmd;        // 命令
+    UBYTE len;        // 参数字节数
+    UBYTE flags;      // EPD_7IN3E_SEQ_*
+    UBYTE delayMs;    // 执行后延时（ms）
+    UBYTE data[6];    // 参数
+} EPD_7IN3E_Cmd;
+
+#define EPD_7IN3E_SEQ_COUNT(seq) (sizeof(seq) / sizeof((seq)[0]))
+
+// 初始化寄存器（复位之后执行）
+static constexpr EPD_7IN3E_Cmd EPD_7IN3E_InitSeq[] = {
+    { 0xAA, 6, 0, 0, { 0x49, 0x55, 0x20, 0x08, 0x09, 0x18 } },  // 命令头
+    { 0x01, 1, 0, 0, { 0x3F } },
+    { 0x00, 2, 0, 0, { 0x5F, 0x69 } },
+    { 0x03, 4, 0, 0, { 0x00, 0x54, 0x00, 0x44 } },
+    { 0x05, 4, 0, 0, { 0x40, 0x1F, 0x1F, 0x2C } },
+    { 0x06, 4, 0, 0, { 0x6F, 0x1F, 0x17, 0x49 } },
+    { 0x08, 4, 0, 0, { 0x6F, 0x1F, 0x1F, 0x22 } },
+    { 0x30, 1, 0, 0, { 0x03 } },
+    { 0x50, 1, 0, 0, { 0x3F } },
+    { 0x60, 2, 0, 0, { 0x02, 0x00 } },
+    { 0x61, 4, 0, 0, { 0x03, 0x20, 0x01, 0xE0 } },              // 800 x 480
+    { 0x84, 1, 0, 0, { 0x01 } },
+    { 0xE3, 1, 0, 0, { 0x2F } },
+    { 0x04, 0, EPD_7IN3E_SEQ_WAIT_BUSY, 0, { 0 } },             // 上电，等待电子纸IC释放空闲信号
+};
+
+// 刷新显示：上电 -> 第二项设置 -> 显示刷新
+static constexpr EPD_7IN3E_Cmd EPD_7IN3E_RefreshSeq[] = {
+    { 0x04, 0, EPD_7IN3E_SEQ_WAIT_BUSY, 0, { 0 } },             // 上电
+    { 0x06, 4, 0, 0, { 0x6F, 0x1F, 0x17, 0x49 } },              // 第二项设置
+    { 0x12, 1, 0, 0, { 0x00 } },                                 // 显示刷新（等待BUSY由调用方负责）
+};
+
+// 断电
+static constexpr EPD_7IN3E_Cmd EPD_7IN3E_PowerOffSeq[] = {
+    { 0x02, 1, EPD_7IN3E_SEQ_WAIT_BUSY, 0, { 0x00 } },
+};
+
+// 深度睡眠（需先断电）
+static constexpr EPD_7IN3E_Cmd EPD_7IN3E_DeepSleepSeq[] = {
+    { 0x07, 1, 0, 0, { 0xA5 } },
+};
+
+/******************************************************************************
+function :  执行命令表
 parameter:
+     seq   : 命令表
+     count : 命令条数
+return   :  某条命令等待BUSY超时时返回 false，后面的命令不再发送
 ******************************************************************************/
-static void EPD_7IN3E_TurnOnDisplay(void)
+static bool EPD_7IN3E_RunSequence(const EPD_7IN3E_Cmd *seq, UWORD count)
 {
-    
-    EPD_7IN3E_SendCommand(0x04); // 上电
-    EPD_7IN3E_ReadBusyH();
+    for (UWORD i = 0; i < count; i++) {
+        DEV_SPI_WriteCommand(seq[i].cmd, seq[i].data, seq[i].len);
+        if ((seq[i].flags & EPD_7IN3E_SEQ_WAIT_BUSY) && !EPD_7IN3E_ReadBusyH()) {
+            return false;
+        }
+        if (seq[i].delayMs) {
+            DEV_Delay_ms(seq[i].delayMs);
+        }
+    }
+    return true;
+}
 
-    // 第二项设置
-    EPD_7IN3E_SendCommand(0x06);
-    EPD_7IN3E_SendData(0x6F);
-    EPD_7IN3E_SendData(0x1F);
-    EPD_7IN3E_SendData(0x17);
-    EPD_7IN3E_SendData(0x49);
+/******************************************************************************
+function :  发出刷新命令后立即返回（不等待BUSY）
+parameter:
+Info:
+    刷新由屏幕控制器自行完成，BUSY变高后还需断电，
+    可调用 EPD_7IN3E_Sleep（断电 + 深度睡眠）收尾。
+return   :  上电等待BUSY超时返回 false，此时刷新命令没有发出
+******************************************************************************/
+bool EPD_7IN3E_RefreshStart(void)
+{
+    return EPD_7IN3E_RunSequence(EPD_7IN3E_RefreshSeq, EPD_7IN3E_SEQ_COUNT(EPD_7IN3E_RefreshSeq));
+}
 
-    EPD_7IN3E_SendCommand(0x12); // 显示刷新
-    EPD_7IN3E_SendData(0x00);
-    EPD_7IN3E_ReadBusyH();
-    
-    EPD_7IN3E_SendCommand(0x02); // 断电
-    EPD_7IN3E_SendData(0X00);
-    EPD_7IN3E_ReadBusyH();
+/******************************************************************************
+function :  开启显示（刷新 + 断电）
+parameter:
+return   :  任一步等待BUSY超时返回 false（画面未确认刷新完成）；
+            超时后不再发断电命令，否则还要再等一次超时，屏幕在下次初始化时复位
+******************************************************************************/
+bool EPD_7IN3E_TurnOnDisplay(void)
+{
+    if (!EPD_7IN3E_RefreshStart() || !EPD_7IN3E_ReadBusyH()) {
+        return false;
+    }
+    return EPD_7IN3E_RunSequence(EPD_7IN3E_PowerOffSeq, EPD_7IN3E_SEQ_COUNT(EPD_7IN3E_PowerOffSeq));
 }
 
 /******************************************************************************
@@ -119,70 +197,18 @@ void EPD_7IN3E_Init(void)
     EPD_7IN3E_ReadBusyH();
     DEV_Delay_ms(30);
 
-    EPD_7IN3E_SendCommand(0xAA);    // 命令头
-    EPD_7IN3E_SendData(0x49);
-    EPD_7IN3E_SendData(0x55);
-    EPD_7IN3E_SendData(0x20);
-    EPD_7IN3E_SendData(0x08);
-    EPD_7IN3E_SendData(0x09);
-    EPD_7IN3E_SendData(0x18);
-
-    EPD_7IN3E_SendCommand(0x01);//
-    EPD_7IN3E_SendData(0x3F);
-
-    EPD_7IN3E_SendCommand(0x00);  
-    EPD_7IN3E_SendData(0x5F);
-    EPD_7IN3E_SendData(0x69);
-
-    EPD_7IN3E_SendCommand(0x03);
-    EPD_7IN3E_SendData(0x00);
-    EPD_7IN3E_SendData(0x54);
-    EPD_7IN3E_SendData(0x00);
-    EPD_7IN3E_SendData(0x44); 
-
-    EPD_7IN3E_SendCommand(0x05);
-    EPD_7IN3E_SendData(0x40);
-    EPD_7IN3E_SendData(0x1F);
-    EPD_7IN3E_SendData(0x1F);
-    EPD_7IN3E_SendData(0x2C);
-
-    EPD_7IN3E_SendCommand(0x06);
-    EPD_7IN3E_SendData(0x6F);
-    EPD_7IN3E_SendData(0x1F);
-    EPD_7IN3E_SendData(0x17);
-    EPD_7IN3E_SendData(0x49);
-
-    EPD_7IN3E_SendCommand(0x08);
-    EPD_7IN3E_SendData(0x6F);
-    EPD_7IN3E_SendData(0x1F);
-    EPD_7IN3E_SendData(0x1F);
-    EPD_7IN3E_SendData(0x22);
-
-    EPD_7IN3E_SendCommand(0x30);
-    EPD_7IN3E_SendData(0x03);
-    
-    EPD_7IN3E_SendCommand(0x50);
-    EPD_7IN3E_SendData(0x3F);
-
-    EPD_7IN3E_SendCommand(0x60);
-    EPD_7IN3E_SendData(0x02);
-    EPD_7IN3E_SendData(0x00);
-
-    EPD_7IN3E_SendCommand(0x61);
-    EPD_7IN3E_SendData(0x03);
-    EPD_7IN3E_SendData(0x20);
-    EPD_7IN3E_SendData(0x01); 
-    EPD_7IN3E_SendData(0xE0);
-
-    EPD_7IN3E_SendCommand(0x84);
-    EPD_7IN3E_SendData(0x01);
-
-    EPD_7IN3E_SendCommand(0xE3);
-    EPD_7IN3E_SendData(0x2F);
-
-    EPD_7IN3E_SendCommand(0x04);     // 上电
-    EPD_7IN3E_ReadBusyH();          // 等待电子纸IC释放空闲信号
+    EPD_7IN3E_RunSequence(EPD_7IN3E_InitSeq, EPD_7IN3E_SEQ_COUNT(EPD_7IN3E_InitSeq));
+}
 
+/******************************************************************************
+function :  开始写入图像数据（命令0x10），之后保持数据模式，
+            调用方用 DEV_SPI_Write_nByte 系列连续发送整帧数据
+parameter:
+******************************************************************************/
+void EPD_7IN3E_BeginImageData(void)
+{
+    EPD_7IN3E_SendCommand(0x10);
+    DEV_Digital_Write(EPD_DC_PIN, 1);
 }
 
 /******************************************************************************
@@ -328,10 +354,6 @@ parameter:
 ******************************************************************************/
 void EPD_7IN3E_Sleep(void)
 {
-    EPD_7IN3E_SendCommand(0X02); // 深度睡眠
-    EPD_7IN3E_SendData(0x00);
-    EPD_7IN3E_ReadBusyH();
-
-    EPD_7IN3E_SendCommand(0x07); // 深度睡眠
-    EPD_7IN3E_SendData(0XA5);
+    EPD_7IN3E_RunSequence(EPD_7IN3E_PowerOffSeq, EPD_7IN3E_SEQ_COUNT(EPD_7IN3E_PowerOffSeq));
+    EPD_7IN3E_RunSequence(EPD_7IN3E_DeepSleepSeq, EPD_7IN3E_SEQ_COUNT(EPD_7IN3E_DeepSleepSeq));
 }
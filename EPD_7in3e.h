@@ -56,6 +56,9 @@ void EPD_7IN3E_Show7Block(void);
 void EPD_7IN3E_Show(void);
 void EPD_7IN3E_Display(UBYTE *Image);
 void EPD_7IN3E_DisplayPart(const UBYTE *Image, UWORD xstart, UWORD ystart, UWORD image_width, UWORD image_heigh);
+void EPD_7IN3E_BeginImageData(void);
+bool EPD_7IN3E_TurnOnDisplay(void);
+bool EPD_7IN3E_RefreshStart(void);
 void EPD_7IN3E_Sleep(void);
 
 #endif
@@ -26,6 +26,7 @@ bool wifiConfigured = false;  // WiFi配网状态标志
 
 /* ------------------------ 用户自定义：长按进入配网 ------------------------ */
 #define WIFI_RECONFIG_HOLD_MS 3000  // 长按GPIO0进入"清除WiFi并AP配网"的阈值（ms）
+#define REDISPLAY_HOLD_MS 1000      // 按住GPIO0 1~3s 后松开：不联网从帧分区重显当前帧
 
 /**
  * 判断是否为正常唤醒原因（按键/定时器/GPIO等）
@@ -38,11 +39,12 @@ static bool isNormalWakeCause(esp_sleep_wakeup_cause_t cause) {
 }
 
 /**
- * 检测 GPIO0 是否被持续按住（低电平）达到指定时长
- * 注意：GPIO0 在本项目作为唤醒键（低电平），这里复用它作为"长按配网"入口。
+ * 测量 GPIO0 从启动起被持续按住（低电平）的时长，最多等到 maxMs
+ * 注意：GPIO0 在本项目作为唤醒键（低电平），这里复用它作为"长按配网"/"重显"入口。
  * 使用 http_update.h 中定义的 WAKEUP_GPIO (GPIO_NUM_0)
+ * @return 按住的毫秒数；启动时未按住为 0，按满 maxMs 时返回 maxMs
  */
-static bool isWakeKeyHeldLow(uint32_t holdMs) {
+static uint32_t wakeKeyHoldMs(uint32_t maxMs) {
   // WAKEUP_GPIO 在 http_update.h 中已定义为 GPIO_NUM_0
   const gpio_num_t wakeupPin = WAKEUP_GPIO;
   
@@ -52,17 +54,17 @@ static bool isWakeKeyHeldLow(uint32_t holdMs) {
 
   // 必须从一开始就是低电平才算"按住"
   if (gpio_get_level(wakeupPin) != 0) {
-    return false;
+    return 0;
   }
 
   uint32_t start = millis();
-  while ((millis() - start) < holdMs) {
+  while ((millis() - start) < maxMs) {
     if (gpio_get_level(wakeupPin) != 0) {
-      return false;  // 中途松开
+      return millis() - start;  // 中途松开
     }
     delay(10);
   }
-  return true;  // 全程按住
+  return maxMs;  // 全程按住
 }
 
 /* Entry point ----------------------------------------------------------------*/
@@ -72,6 +74,11 @@ void setup()
     Serial.begin(115200);
     delay(10);
     
+    // RTC 中的设备状态：深睡唤醒时直接使用，冷启动时从 NVS 载入一次（见 device_state.h）
+    deviceStateInit();
+    // 唤醒耗时记录（esp_timer 从启动开始计时，见 wake_timing.h）
+    wakeTimingInit();
+    
     // 初始化官方Demo的硬件接口
     #include "DEV_Config.h"
     DEV_Module_Init();
@@ -92,13 +99,19 @@ void setup()
     esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
     Serial.printf("⏰ wakeup cause = %d\n", (int)cause);
 
+    // 0) 上次唤醒发出刷新后深睡：只做收尾（屏幕睡眠 + 提交版本号），不联网
+    if (HTTP_UPDATE__resumePendingRefresh()) {
+        return;
+    }
+
     // 先读一次"是否已配网"（不改变现有逻辑，仅用于门控）
     bool alreadyConfigured = checkWiFiConfigured();
 
     // 1) 长按 GPIO0 进入"清除WiFi + AP配网"
     //    - 适用于：从 deep-sleep 按键唤醒后继续按住不放
     //    - 也适用于：上电/复位后按住 GPIO0（若硬件允许）
-    if (isWakeKeyHeldLow(WIFI_RECONFIG_HOLD_MS)) {
+    uint32_t holdMs = wakeKeyHoldMs(WIFI_RECONFIG_HOLD_MS);
+    if (holdMs >= WIFI_RECONFIG_HOLD_MS) {
         Serial.println("🧹 检测到长按GPIO0：清除WiFi配置并进入AP配网模式");
         clearWiFiConfig();       // 清除NVS WiFi信息
         startAPMode();           // 启动AP
@@ -108,6 +121,24 @@ void setup()
         return;  // AP模式下不进入Deep-sleep
     }
 
+    // 1.5) 不联网重显当前帧（帧分区中版本和 SHA-256 都对得上时）：
+    //    - 按住 GPIO0 1~3s 后松开
+    //    - 复位/上电时屏幕画面不是当前帧（设备码覆盖过，或刷新被复位打断；欠压复位除外）
+    //    没有可重显的帧时继续下面的流程
+    if (holdMs >= REDISPLAY_HOLD_MS ||
+        (!isNormalWakeCause(cause) && HTTP_UPDATE__panelNeedsRedisplay())) {
+        if (HTTP_UPDATE__redisplayOffline()) {
+            return;
+        }
+    }
+
+    // 1.6) 播放列表模式：定时唤醒/短按 GPIO0 时不联网显示下一页（各页已预取到帧分区）
+    //    清单到期需要联网检查时继续下面的流程
+    if (holdMs < REDISPLAY_HOLD_MS && isNormalWakeCause(cause) &&
+        HTTP_UPDATE__playlistRotateOffline(cause)) {
+        return;
+    }
+
     // 2) 只保留"GPIO0唤醒/定时唤醒"作为正常工作触发
     //    - 如果是复位/上电等"非正常唤醒"，且已经配过网：直接回睡，不再触发联网更新
     //    - 如果未配网：允许继续走配网流程（否则永远没法配网）
@@ -120,7 +151,9 @@ void setup()
     // WiFi配网初始化
     Serial.println("📶 WiFi配网初始化...");
     
+    wakeTimingSwitch(WAKE_PHASE_WIFI);
     bool wifiConnected = initWiFiConfig();
+    wakeTimingSwitch(WAKE_PHASE_STATUS);
     
     if (!wifiConnected) {
         // AP配网模式
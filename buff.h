@@ -12,6 +12,8 @@
   ******************************************************************************
   */ 
 
+#include "epd_decode.h"
+
 /* Size, current position index and byte array of the buffer -----------------*/
 #define Buff__SIZE 2050
 int     Buff__bufInd;
@@ -21,13 +23,11 @@ char    Buff__bufArr[Buff__SIZE];
 int Buff__getByte(int index)
 {
     // The first and second characters of the byte stored in the buffer
-    // are supposed to be in range ['a'; 'p'], otherwise it isn't a image data's byte
-    if ((Buff__bufArr[index    ] < 'a') || (Buff__bufArr[index    ] > 'p')) return -1;
-    if ((Buff__bufArr[index + 1] < 'a') || (Buff__bufArr[index + 1] > 'p')) return -1;
-
+    // are supposed to be in range ['a'; 'p'], otherwise it isn't a image data's byte.
     // The character 'a' means 0, the character 'p' means 15 consequently,
     // The 1st character describes 4 low bits if the byte and the 2nd one - 4 high bits 
-    return ((int)Buff__bufArr[index] - 'a') + (((int)Buff__bufArr[index + 1] - 'a') << 4);
+    // (shared with the streaming loader, see epd_decode.h)
+    return EPD_decodeCharPair(Buff__bufArr[index], Buff__bufArr[index + 1]);
 }
 
 /* Reads a byte from the buffer at specified position ------------------------*/
@@ -8,13 +8,16 @@ Deep-sleep + HTTP Pull Architecture (无MQTT版本)
 """
 
 import os
+import re
 import json
 import time
+import base64
 import threading
 import hashlib
 import secrets
+import zlib
 from datetime import datetime, timedelta
-from functools import wraps
+from functools import wraps, lru_cache
 from pathlib import Path
 
 from flask import Flask, request, jsonify, send_file, Response
@@ -25,7 +28,11 @@ import tempfile
 import io
 
 from config import Config
-from six_color_epd import process_e6_image_from_base64
+from PIL import Image
+from six_color_epd import process_e6_image, process_e6_image_from_base64
+from epd_frame import build_bin4_frame, build_rle4_frame, build_delta_frame, parse_frame_header
+from epd_status import parse_status_request, build_status_response
+from epd_playlist import build_playlist_manifest, PLAYLIST_MAX_PAGES
 
 # ==================== Flask 应用初始化 ====================
 app = Flask(__name__)
@@ -55,6 +62,38 @@ def validate_epd_text_payload(image_data: str):
         return False, f'Invalid chars: {bad}'
     return True, None
 
+# 4bit 打包数据 -> a~p 文本：与前端 uploadToDevice 的编码一致（每字节先低 4 位、后高 4 位）
+EPD_NIBBLE_TEXT = [bytes((97 + (i & 0x0F), 97 + (i >> 4))) for i in range(256)]
+
+def epd_text_from_4bit(data_4bit: bytes) -> str:
+    return b''.join(EPD_NIBBLE_TEXT[b] for b in data_4bit).decode('ascii')
+
+# 设备可协商的下载格式：text = a~p 文本（所有设备都支持），
+# bin = EPDF 二进制帧，rle = EPDF 按行 RLE 帧，delta = 相对设备基准帧的差分帧（见 epd_frame.py）
+EPD_FORMAT_TEXT = 'text'
+EPD_FORMAT_BIN = 'bin'
+EPD_FORMAT_RLE = 'rle'
+EPD_FORMAT_DELTA = 'delta'
+EPD_FRAME_BUILDERS = {
+    EPD_FORMAT_BIN: build_bin4_frame,
+    EPD_FORMAT_RLE: build_rle4_frame,
+}
+# 差分更新的基准：每个设备保留最近几个版本的 bin 帧
+EPD_HISTORY_KEEP = 8
+# 播放列表：设备未声明 X-EPD-Playlist-Max 时最多下发的页数；页面渲染用的抖动算法
+EPD_PLAYLIST_DEFAULT_PAGES = 4
+EPD_PAGE_ALGORITHM = 'floyd_steinberg'
+
+def parse_device_formats(value) -> set:
+    """解析设备在 status 请求中声明的 formats（列表或逗号分隔字符串），缺省只支持 text"""
+    if isinstance(value, str):
+        value = value.split(',')
+    if not isinstance(value, (list, tuple)):
+        return {EPD_FORMAT_TEXT}
+    formats = {str(v).strip().lower() for v in value if v}
+    formats.add(EPD_FORMAT_TEXT)
+    return formats
+
 # ==================== MongoDB 连接 ====================
 mongo_client = None
 db = None
@@ -64,9 +103,12 @@ device_status_collection = None
 pages_collection = None
 page_lists_collection = None
 pairing_codes_collection = None
+wake_timings_collection = None
 
 # ==================== 图片持久化存储目录 ====================
-# 图片数据保存在 data/epd/<deviceId>/latest.txt
+# 图片数据保存在 data/epd/<deviceId>/latest.txt，二进制帧保存在同目录 latest.bin / latest.rle，
+# 历史版本的 bin 帧保存在 history/v<版本>.bin，差分帧缓存在 delta/v<基准>-v<目标>.bin，
+# 播放列表中各页渲染出的数据保存在 pages/<pageId>.txt / .bin / .rle
 DATA_DIR = Path(__file__).parent / 'data' / 'epd'
 DATA_DIR.mkdir(parents=True, exist_ok=True)
 
@@ -80,21 +122,41 @@ def get_device_image_path(device_id: str) -> Path:
     """获取设备最新图片文件路径"""
     return get_device_data_dir(device_id) / 'latest.txt'
 
+def get_device_frame_path(device_id: str, fmt: str) -> Path:
+    """获取设备最新二进制帧文件路径（fmt 为 EPD_FRAME_BUILDERS 中的格式）"""
+    return get_device_data_dir(device_id) / f'latest.{fmt}'
+
+def get_device_history_path(device_id: str, version: int) -> Path:
+    """获取设备历史版本 bin 帧路径"""
+    return get_device_data_dir(device_id) / 'history' / f'v{version}.bin'
+
+def get_device_delta_path(device_id: str, base_version: int, target_version: int) -> Path:
+    """获取差分帧缓存路径"""
+    return get_device_data_dir(device_id) / 'delta' / f'v{base_version}-v{target_version}.bin'
+
+def get_page_frame_path(device_id: str, page_id: str, fmt: str) -> Path:
+    """获取页面渲染数据路径（fmt 为 text 或 EPD_FRAME_BUILDERS 中的格式）"""
+    ext = 'txt' if fmt == EPD_FORMAT_TEXT else fmt
+    return get_device_data_dir(device_id) / 'pages' / f'{page_id}.{ext}'
+
+def atomic_write_bytes(path: Path, data: bytes):
+    """原子写入：先写临时文件，再 replace，避免出现“文件被半写入”的情况"""
+    tmp_path = path.with_suffix(path.suffix + '.tmp')
+    with open(tmp_path, 'wb') as f:
+        f.write(data)
+        f.flush()
+        try:
+            os.fsync(f.fileno())
+        except Exception:
+            # 某些环境/文件系统可能不支持 fsync，忽略但仍然 replace
+            pass
+    tmp_path.replace(path)
+
 def save_device_image(device_id: str, image_data: str) -> bool:
     """保存设备图片数据到磁盘"""
     try:
         image_path = get_device_image_path(device_id)
-        # 原子写入：先写临时文件，再 replace，避免出现“文件被半写入”的情况
-        tmp_path = image_path.with_suffix(image_path.suffix + '.tmp')
-        with open(tmp_path, 'w', encoding='utf-8', newline='') as f:
-            f.write(image_data)
-            f.flush()
-            try:
-                os.fsync(f.fileno())
-            except Exception:
-                # 某些环境/文件系统可能不支持 fsync，忽略但仍然 replace
-                pass
-        tmp_path.replace(image_path)
+        atomic_write_bytes(image_path, image_data.encode('utf-8'))
 
         print(f'💾 图片已保存: {image_path} ({len(image_data)} 字符)')
         return True
@@ -102,6 +164,216 @@ def save_device_image(device_id: str, image_data: str) -> bool:
         print(f'❌ 保存图片失败: {e}')
         return False
 
+def save_device_frame(device_id: str, fmt: str, frame: bytes) -> bool:
+    """保存设备二进制帧到磁盘"""
+    try:
+        frame_path = get_device_frame_path(device_id, fmt)
+        atomic_write_bytes(frame_path, frame)
+        print(f'💾 二进制帧已保存: {frame_path} ({len(frame)} 字节)')
+        return True
+    except Exception as e:
+        print(f'❌ 保存二进制帧失败: {e}')
+        return False
+
+def ensure_device_frame(device_id: str, fmt: str):
+    """确保二进制帧存在且不比文本数据旧（旧数据首次被请求时按需生成），失败返回 None"""
+    image_path = get_device_image_path(device_id)
+    frame_path = get_device_frame_path(device_id, fmt)
+    if not image_path.exists():
+        return None
+    if frame_path.exists() and frame_path.stat().st_mtime >= image_path.stat().st_mtime:
+        return frame_path
+
+    image_data = load_device_image(device_id)
+    ok, err = validate_epd_text_payload(image_data)
+    if not ok:
+        print(f'❌ 无法生成二进制帧: {device_id} -> {err}')
+        return None
+    if not save_device_frame(device_id, fmt, EPD_FRAME_BUILDERS[fmt](image_data, EPD_WIDTH, EPD_HEIGHT)):
+        return None
+    return frame_path
+
+def save_frame_history(device_id: str, version: int, frame: bytes):
+    """记录新版本的 bin 帧作为以后差分的基准，只保留最近 EPD_HISTORY_KEEP 个版本；旧差分缓存全部失效"""
+    try:
+        history_path = get_device_history_path(device_id, version)
+        history_path.parent.mkdir(parents=True, exist_ok=True)
+        atomic_write_bytes(history_path, frame)
+        old = sorted(history_path.parent.glob('v*.bin'), key=lambda p: int(p.stem[1:]))
+        for p in old[:-EPD_HISTORY_KEEP]:
+            p.unlink(missing_ok=True)
+        delta_dir = get_device_data_dir(device_id) / 'delta'
+        if delta_dir.exists():
+            for p in delta_dir.glob('*.bin'):
+                p.unlink(missing_ok=True)
+    except Exception as e:
+        print(f'⚠️  保存历史帧失败（不影响发布，只是无法差分）: {e}')
+
+def ensure_delta_frame(device_id: str, base_version: int, base_crc: int, target_version: int):
+    """生成（或复用缓存的）差分帧
+
+    设备的基准帧与历史记录不一致、历史已被清理、或差分不比完整帧小时返回 None
+    """
+    base_path = get_device_history_path(device_id, base_version)
+    target_path = get_device_history_path(device_id, target_version)
+    if not base_path.exists() or not target_path.exists():
+        return None
+    base_frame = base_path.read_bytes()
+    header = parse_frame_header(base_frame)
+    if header is None or header['crc32'] != base_crc:
+        print(f'⚠️  设备 {device_id} 的基准帧与 v{base_version} 不一致，改为下发完整帧')
+        return None
+
+    delta_path = get_device_delta_path(device_id, base_version, target_version)
+    if delta_path.exists():
+        return delta_path
+    delta = build_delta_frame(base_frame, target_path.read_bytes())
+    if delta is None:
+        return None
+    delta_path.parent.mkdir(parents=True, exist_ok=True)
+    atomic_write_bytes(delta_path, delta)
+    print(f'💾 差分帧已生成: {delta_path} ({len(delta)} 字节)')
+    return delta_path
+
+def get_frame_sha256(device, fmt: str, frame_path: Path) -> str:
+    """二进制帧的 SHA256：优先用发布时记录的值，旧数据现算"""
+    meta = ((device or {}).get('imageFrames') or {}).get(fmt) or {}
+    return meta.get('sha256') or file_sha256(frame_path)
+
+def ensure_page_frame(clean_id: str, page: dict, fmt: str):
+    """确保页面渲染出的数据存在且不比页面旧（播放列表预取用），失败返回 None
+
+    页面保存的是编辑器画布（data.imageData，JPEG data URL），这里做 E6 六色抖动后生成 a~p 文本
+    和各二进制帧；模板页只保存了 templateId（由浏览器渲染），云端没有图像，返回 None
+    """
+    page_id = page.get('pageId')
+    image_url = (page.get('data') or {}).get('imageData')
+    if not page_id or not isinstance(image_url, str) or ',' not in image_url:
+        return None
+    text_path = get_page_frame_path(clean_id, page_id, EPD_FORMAT_TEXT)
+    frame_path = get_page_frame_path(clean_id, page_id, fmt)
+    updated = page.get('updatedAt')
+    stamp = (updated - datetime(1970, 1, 1)).total_seconds() if isinstance(updated, datetime) else 0
+    if text_path.exists() and text_path.stat().st_mtime >= stamp:
+        if fmt == EPD_FORMAT_TEXT or (frame_path.exists() and frame_path.stat().st_mtime >= text_path.stat().st_mtime):
+            return frame_path
+
+    try:
+        img = Image.open(io.BytesIO(base64.b64decode(image_url.split(',', 1)[1])))
+        result = process_e6_image(img, target_size=(EPD_WIDTH, EPD_HEIGHT), algorithm=EPD_PAGE_ALGORITHM)
+    except Exception as e:
+        print(f'❌ 页面渲染失败: {clean_id}/{page_id} -> {e}')
+        return None
+    image_data = epd_text_from_4bit(result['data_4bit'])
+    ok, err = validate_epd_text_payload(image_data)
+    if not ok:
+        print(f'❌ 页面渲染结果无效: {clean_id}/{page_id} -> {err}')
+        return None
+    # 先写文本，再写帧，保证帧的 mtime 不早于文本
+    text_path.parent.mkdir(parents=True, exist_ok=True)
+    atomic_write_bytes(text_path, image_data.encode('ascii'))
+    for name, build in EPD_FRAME_BUILDERS.items():
+        atomic_write_bytes(get_page_frame_path(clean_id, page_id, name), build(image_data, EPD_WIDTH, EPD_HEIGHT))
+    print(f'💾 页面已渲染: {clean_id}/{page_id}')
+    return frame_path
+
+def select_page_download(clean_id: str, page: dict, device_formats: set):
+    """为播放列表中的一页选择下发格式：设备支持的二进制帧中最小的，都不支持时为 a~p 文本
+
+    返回 {format, size, sha256, url}；页面无法渲染时返回 None
+    """
+    best = None
+    for fmt in [f for f in EPD_FRAME_BUILDERS if f in device_formats] or [EPD_FORMAT_TEXT]:
+        path = ensure_page_frame(clean_id, page, fmt)
+        if path is None:
+            return None
+        size = path.stat().st_size
+        if best is None or size < best[2]:
+            best = (fmt, path, size)
+    fmt, path, size = best
+    sha256 = file_sha256(path)
+    # URL 带上内容哈希：页面修改后地址随之变化，设备不会把旧数据当作同一下载续传
+    url = (f'http://{Config.FLASK_HOST}:{Config.FLASK_PORT}/api/epd/page/{clean_id}/{page["pageId"]}'
+           f'?fmt={fmt}&h={sha256[:16]}')
+    return {'format': fmt, 'size': size, 'sha256': sha256, 'url': url}
+
+# 下载压缩：设备用 ROM 内置的 tinfl 边收边解压，解压窗口（log2）由请求头 X-EPD-Inflate-Window 声明，
+# 压缩时的窗口不能超过它；不带该头的普通客户端（浏览器）按 zlib 默认的 32KB 窗口
+EPD_COMPRESS_LEVEL = 9
+EPD_WINDOW_BITS_MIN = 9
+EPD_WINDOW_BITS_MAX = 15
+
+def negotiate_content_encoding():
+    """根据 Accept-Encoding 选择 deflate 或 gzip，都不接受时返回 None
+
+    同等权重时优先 deflate：zlib 头里带窗口大小，设备端可以校验
+    （设备的 HTTPClient 还会带一条 identity;q=1,...,*;q=0 的默认头，WSGI 会与之合并，只看显式列出的编码）
+    """
+    best, best_q = None, 0
+    for encoding in ('deflate', 'gzip'):
+        q = request.accept_encodings[encoding]
+        if q > best_q:
+            best, best_q = encoding, q
+    return best
+
+def request_window_bits() -> int:
+    """设备声明的解压窗口（log2），限制在 zlib 支持的范围内"""
+    try:
+        bits = int(request.headers.get('X-EPD-Inflate-Window', EPD_WINDOW_BITS_MAX))
+    except ValueError:
+        bits = EPD_WINDOW_BITS_MAX
+    return max(EPD_WINDOW_BITS_MIN, min(EPD_WINDOW_BITS_MAX, bits))
+
+@lru_cache(maxsize=16)
+def _compress_file_cached(path_str: str, mtime_ns: int, size: int, encoding: str, window_bits: int) -> bytes:
+    """压缩文件内容；mtime/size 作为缓存键的一部分，文件重新发布后自动失效"""
+    wbits = window_bits if encoding == 'deflate' else 16 + window_bits
+    compressor = zlib.compressobj(EPD_COMPRESS_LEVEL, zlib.DEFLATED, wbits)
+    with open(path_str, 'rb') as f:
+        return compressor.compress(f.read()) + compressor.flush()
+
+def compressed_file_response(path: Path, mimetype: str):
+    """客户端接受 deflate/gzip 时返回压缩后的响应，否则返回 None（调用方继续用 send_file）"""
+    encoding = negotiate_content_encoding()
+    if encoding is None:
+        return None
+    window_bits = request_window_bits()
+    st = path.stat()
+    body = _compress_file_cached(str(path), st.st_mtime_ns, st.st_size, encoding, window_bits)
+    print(f'   压缩传输: {encoding}（窗口 {1 << window_bits} 字节）{st.st_size} -> {len(body)} 字节')
+    resp = Response(body, mimetype=mimetype)
+    resp.headers['Content-Encoding'] = encoding
+    resp.headers['Vary'] = 'Accept-Encoding'
+    return resp
+
+def raw_file_response(path: Path, mimetype: str, sha256: str):
+    """设备下载文件的响应：优先压缩传输，带 Range 的请求（设备断点续传）直接按字节范围发送原文件
+
+    ETag 用文件内容的 SHA256，并在 X-EPD-Resume-ETag 中重复给出：压缩响应没有 ETag，
+    但设备保存的是解压后的数据，即原文件的前缀，续传时用这个值作 If-Range；
+    文件已重新发布（ETag 不符）时 send_file 忽略 Range 返回完整的 200
+    """
+    resp = None if request.range else compressed_file_response(path, mimetype)
+    if resp is None:
+        resp = send_file(
+            path,
+            mimetype=mimetype,
+            conditional=True,
+            etag=sha256,
+            max_age=0
+        )
+        resp.headers['Accept-Ranges'] = 'bytes'
+    resp.headers['X-EPD-Resume-ETag'] = f'"{sha256}"'
+    return resp
+
+def file_sha256(path: Path) -> str:
+    """计算文件 SHA256"""
+    h = hashlib.sha256()
+    with open(path, 'rb') as f:
+        for chunk in iter(lambda: f.read(65536), b''):
+            h.update(chunk)
+    return h.hexdigest()
+
 def load_device_image(device_id: str) -> str:
     """从磁盘加载设备图片数据"""
     try:
@@ -116,7 +388,7 @@ def load_device_image(device_id: str) -> str:
 def connect_mongodb():
     """连接 MongoDB"""
     global mongo_client, db, users_collection, devices_collection, device_status_collection
-    global pages_collection, page_lists_collection, pairing_codes_collection
+    global pages_collection, page_lists_collection, pairing_codes_collection, wake_timings_collection
     try:
         mongo_client = MongoClient(Config.MONGODB_URI, serverSelectionTimeoutMS=5000)
         # 测试连接
@@ -128,6 +400,7 @@ def connect_mongodb():
         pages_collection = db['pages']
         page_lists_collection = db['page_lists']
         pairing_codes_collection = db['pairing_codes']
+        wake_timings_collection = db['wake_timings']
         
         # 创建索引
         users_collection.create_index('username', unique=True)
@@ -151,6 +424,10 @@ def connect_mongodb():
         
         pairing_codes_collection.create_index('deviceId', unique=True)
         pairing_codes_collection.create_index('expiresAt', expireAfterSeconds=0)
+
+        # 同一条唤醒记录可能重复上报（设备没收到响应时下次重发），按 deviceId+bootId+seq 去重
+        wake_timings_collection.create_index([('deviceId', 1), ('bootId', 1), ('seq', 1)], unique=True)
+        wake_timings_collection.create_index('receivedAt', expireAfterSeconds=WAKE_TIMING_TTL_SECONDS)
         
         print(f'✅ Connected to MongoDB: {Config.MONGODB_URI}')
         print(f'📊 Database: {Config.MONGODB_DB}')
@@ -463,8 +740,280 @@ def get_devices_status():
         print(f'❌ Error fetching device status: {e}')
         return jsonify({'success': False, 'error': str(e)}), 500
 
+@app.route('/api/devices/timing', methods=['GET'])
+@login_required
+def get_devices_timing():
+    """当前用户设备的唤醒耗时统计：各阶段及总清醒时间的 p50/p95（毫秒）
+
+    参数：deviceId（可选，只统计该设备）、days（最近几天，默认 7）
+    """
+    try:
+        user = getattr(request, 'user', None)
+        owner = user.get('username') if user else None
+        device_id = normalize_device_id(request.args.get('deviceId', ''))
+        try:
+            days = min(max(int(request.args.get('days', 7)), 1), 30)
+        except ValueError:
+            days = 7
+
+        if device_id:
+            if not ensure_device_owner(device_id, user):
+                return jsonify({'success': False, 'error': 'Device not found or no permission'}), 403
+            device_ids = [device_id]
+        elif devices_collection is not None and owner:
+            device_ids = [d['deviceId'] for d in devices_collection.find({'owner': owner}, {'deviceId': 1})]
+        else:
+            device_ids = []
+
+        records = []
+        if wake_timings_collection is not None and device_ids:
+            records = list(wake_timings_collection.find(
+                {'deviceId': {'$in': device_ids}, 'receivedAt': {'$gte': datetime.utcnow() - timedelta(days=days)}},
+                {'_id': 0, 'totalMs': 1, 'phases': 1}
+            ))
+
+        def summarize(values):
+            values = sorted(values)
+            return {'p50': percentile(values, 50), 'p95': percentile(values, 95)}
+
+        phases = {
+            phase: summarize([r['phases'].get(phase, 0) for r in records if 'phases' in r])
+            for phase in WAKE_PHASES
+        }
+        return jsonify({
+            'success': True,
+            'days': days,
+            'devices': len(device_ids),
+            'wakes': len(records),
+            'totalMs': summarize([r.get('totalMs', 0) for r in records]),
+            'phases': phases,
+        })
+    except Exception as e:
+        print(f'❌ Error fetching wake timing: {e}')
+        return jsonify({'success': False, 'error': str(e)}), 500
+
+def select_device_download(clean_id: str, device: dict, device_formats: set, base_version=None, base_crc=None):
+    """为设备选择要下发的数据（status 和条件 GET 共用）
+
+    设备支持二进制帧时在支持的格式中选最小的（RLE 对噪声图可能比 bin 大）；
+    支持差分的设备只能以 bin 帧作为基准帧，整帧固定下发 bin，基准帧仍在历史中时只下发变化的行。
+    返回 {format, path, size, sha256, url}，size/sha256 均指实际下发的数据；没有图片时返回 None
+    """
+    image_version = device.get('imageVersion', 0)
+    image_path = get_device_image_path(clean_id)
+    if not image_path.exists() or image_version <= 0:
+        return None
+
+    # 构建稳定的下载URL
+    image_url = f'http://{Config.FLASK_HOST}:{Config.FLASK_PORT}/api/epd/raw/{clean_id}?v={image_version}'
+    download = {
+        'format': EPD_FORMAT_TEXT,
+        'path': image_path,
+        'size': device.get('imageSizeChars'),
+        'sha256': device.get('imageSha256'),
+        'url': image_url,
+    }
+
+    full_formats = EPD_FRAME_BUILDERS
+    delta_capable = EPD_FORMAT_DELTA in device_formats and EPD_FORMAT_BIN in device_formats
+    if delta_capable:
+        full_formats = [EPD_FORMAT_BIN]
+    best = None
+    for fmt in full_formats:
+        if fmt not in device_formats:
+            continue
+        frame_path = ensure_device_frame(clean_id, fmt)
+        if frame_path is None:
+            continue
+        size = frame_path.stat().st_size
+        if best is None or size < best[2]:
+            best = (fmt, frame_path, size)
+    if best is not None:
+        fmt, frame_path, size = best
+        download = {
+            'format': fmt,
+            'path': frame_path,
+            'size': size,
+            'sha256': get_frame_sha256(device, fmt, frame_path),
+            'url': image_url + f'&fmt={fmt}',
+        }
+
+    if (delta_capable and isinstance(base_version, int) and isinstance(base_crc, int)
+            and 0 < base_version < image_version):
+        delta_path = ensure_delta_frame(clean_id, base_version, base_crc, image_version)
+        if delta_path is not None:
+            size = delta_path.stat().st_size
+            download = {
+                'format': EPD_FORMAT_DELTA,
+                'path': delta_path,
+                'size': size,
+                'sha256': file_sha256(delta_path),
+                'url': image_url + f'&fmt={EPD_FORMAT_DELTA}&base={base_version}',
+            }
+            print(f'   差分更新: v{base_version} -> v{image_version}, {size} 字节')
+    return download
+
+def touch_device_last_seen(clean_id: str):
+    """更新设备最后活动时间"""
+    if device_status_collection is not None:
+        device_status_collection.update_one(
+            {'deviceId': clean_id},
+            {'$set': {
+                'lastSeen': int(time.time() * 1000),
+                'updatedAt': datetime.utcnow()
+            }},
+            upsert=True
+        )
+
+# ==================== 唤醒耗时统计 ====================
+
+# 与设备 wake_timing.h 中 WakePhase 的顺序一致
+WAKE_PHASES = ['boot', 'wifi', 'status', 'download', 'decode', 'panelInit', 'refresh', 'sleepPrep']
+WAKE_TIMING_TTL_SECONDS = 30 * 24 * 3600
+WAKE_TIMING_MAX_RECORDS = 16
+
+def parse_wake_timing(value):
+    """解析设备上报的紧凑耗时记录："<bootId>;seq,cause,total,p0..p7;..."
+
+    字段数不对或不是数字的记录丢弃；返回 (bootId, [记录]) ，无效时返回 (None, [])
+    """
+    if not isinstance(value, str) or ';' not in value:
+        return None, []
+    parts = value.strip().split(';')
+    boot_id = parts[0].strip().lower()
+    if not boot_id or len(boot_id) > 8:
+        return None, []
+    records = []
+    for part in parts[1:WAKE_TIMING_MAX_RECORDS + 1]:
+        fields = part.split(',')
+        if len(fields) != 3 + len(WAKE_PHASES):
+            continue
+        try:
+            numbers = [int(f) for f in fields]
+        except ValueError:
+            continue
+        if any(n < 0 for n in numbers):
+            continue
+        seq, cause, total_ms = numbers[:3]
+        records.append({
+            'seq': seq,
+            'cause': cause,
+            'totalMs': total_ms,
+            'phases': dict(zip(WAKE_PHASES, numbers[3:])),
+        })
+    return boot_id, records
+
+def store_wake_timing(clean_id: str, value):
+    """保存设备上报的唤醒耗时记录（重复上报的记录覆盖原记录）"""
+    if wake_timings_collection is None or not value:
+        return
+    boot_id, records = parse_wake_timing(value)
+    if not records:
+        return
+    now = datetime.utcnow()
+    try:
+        for record in records:
+            wake_timings_collection.update_one(
+                {'deviceId': clean_id, 'bootId': boot_id, 'seq': record['seq']},
+                {'$set': {**record, 'receivedAt': now}},
+                upsert=True
+            )
+    except Exception as e:
+        print(f'⚠️  保存唤醒耗时失败: {e}')
+
+def percentile(sorted_values, p: float):
+    """最近秩百分位（sorted_values 已升序）"""
+    if not sorted_values:
+        return None
+    rank = max(1, int(-(-p * len(sorted_values) // 100)))
+    return sorted_values[min(rank, len(sorted_values)) - 1]
+
 # ==================== API: 设备绑定状态查询和绑定 ====================
 
+def build_device_status(clean_id: str, device_formats: set, base_version=None, base_crc=None, timing=None):
+    """status 的查询结果（JSON 和二进制接口共用）
+
+    未绑定时生成/返回配对码；数据库未连接时返回 None
+    """
+    touch_device_last_seen(clean_id)
+    store_wake_timing(clean_id, timing)
+    
+    if devices_collection is None:
+        return None
+    
+    device = devices_collection.find_one({'deviceId': clean_id})
+    claimed = device is not None and device.get('claimed', False)
+    
+    response = {
+        'success': True,
+        'deviceId': clean_id,
+        'claimed': claimed
+    }
+    
+    if claimed and device:
+        # 已绑定：返回图片版本和下载URL
+        image_version = device.get('imageVersion', 0)
+        response['imageVersion'] = image_version
+    
+        # 检查是否有持久化的图片
+        download = select_device_download(clean_id, device, device_formats, base_version, base_crc)
+        if download is not None:
+            response['imageUrl'] = download['url']
+            # 返回云端侧元数据，设备可做轻量校验（不强制）
+            if device.get('imageSizeChars') is not None:
+                response['imageSizeChars'] = device.get('imageSizeChars')
+            response['imageFormat'] = download['format']
+            if download['size'] is not None:
+                response['imageSize'] = download['size']
+            if download['sha256']:
+                response['imageSha256'] = download['sha256']
+    
+        print(f'📊 设备 {clean_id} 查询状态: claimed=True, imageVersion={image_version}')
+    else:
+        # 未绑定：生成或返回配对码
+        response['imageVersion'] = 0
+    
+        pairing_code = None
+        expires_at = None
+    
+        if pairing_codes_collection is not None:
+            pairing_doc = pairing_codes_collection.find_one({'deviceId': clean_id})
+            if pairing_doc:
+                pairing_code = pairing_doc.get('code')
+                expires_at = pairing_doc.get('expiresAt')
+    
+        if not pairing_code or (expires_at and expires_at < datetime.utcnow()):
+            import random
+            pairing_code = f"{random.randint(100000, 999999)}"
+            expires_at = datetime.utcnow() + timedelta(hours=24)
+    
+            if pairing_codes_collection is not None:
+                pairing_codes_collection.update_one(
+                    {'deviceId': clean_id},
+                    {
+                        '$set': {
+                            'code': pairing_code,
+                            'expiresAt': expires_at,
+                            'createdAt': datetime.utcnow()
+                        }
+                    },
+                    upsert=True
+                )
+    
+        if expires_at:
+            expires_in = int((expires_at - datetime.utcnow()).total_seconds())
+            if expires_in < 0:
+                expires_in = 0
+        else:
+            expires_in = 86400
+    
+        response['pairingCode'] = pairing_code
+        response['expiresIn'] = expires_in
+    
+        print(f'📊 设备 {clean_id} 查询状态: claimed=False, pairingCode={pairing_code}')
+    
+    return response
+
 @app.route('/api/device/status', methods=['POST'])
 def device_status():
     """设备查询绑定状态（无需登录，设备调用）
@@ -473,11 +1022,19 @@ def device_status():
     - claimed: 是否已绑定
     - imageVersion: 最新图片版本号
     - imageUrl: 图片下载URL（仅已绑定且有图片时返回）
+    - imageFormat / imageSize: imageUrl 返回的数据格式（text/bin/rle/delta）和字节数
     - pairingCode: 配对码（仅未绑定时返回）
+
+    请求可带 formats（如 ["bin", "text"]）声明设备支持的格式，不带则按 text 处理（兼容旧固件）；
+    支持 delta 的设备同时带 baseVersion / baseCrc（设备上保存的基准帧），云端据此下发差分帧；
+    timing 为之前几次唤醒的分阶段耗时（格式见 parse_wake_timing）
     """
     try:
         data = request.get_json() or {}
         device_id = (data.get('deviceId') or '').strip().upper()
+        device_formats = parse_device_formats(data.get('formats'))
+        base_version = data.get('baseVersion')
+        base_crc = data.get('baseCrc')
         
         if not device_id:
             return jsonify({'success': False, 'error': 'Missing deviceId'}), 400
@@ -488,89 +1045,10 @@ def device_status():
         if not re.match(r'^[0-9A-F]{6}$|^[0-9A-F]{12}$', clean_id):
             return jsonify({'success': False, 'error': 'Invalid deviceId format'}), 400
         
-        # 更新设备最后活动时间
-        if device_status_collection is not None:
-            device_status_collection.update_one(
-                {'deviceId': clean_id},
-                {'$set': {
-                    'lastSeen': int(time.time() * 1000),
-                    'updatedAt': datetime.utcnow()
-                }},
-                upsert=True
-            )
-        
-        if devices_collection is None:
+        response = build_device_status(clean_id, device_formats, base_version, base_crc, data.get('timing'))
+        if response is None:
             return jsonify({'success': False, 'error': 'Database not connected'}), 500
         
-        device = devices_collection.find_one({'deviceId': clean_id})
-        claimed = device is not None and device.get('claimed', False)
-        
-        response = {
-            'success': True,
-            'deviceId': clean_id,
-            'claimed': claimed
-        }
-        
-        if claimed and device:
-            # 已绑定：返回图片版本和下载URL
-            image_version = device.get('imageVersion', 0)
-            response['imageVersion'] = image_version
-            
-            # 检查是否有持久化的图片
-            image_path = get_device_image_path(clean_id)
-            if image_path.exists() and image_version > 0:
-                # 构建稳定的下载URL
-                response['imageUrl'] = f'http://{Config.FLASK_HOST}:{Config.FLASK_PORT}/api/epd/raw/{clean_id}?v={image_version}'
-                # 返回云端侧元数据，设备可做轻量校验（不强制）
-                if device.get('imageSizeChars') is not None:
-                    response['imageSizeChars'] = device.get('imageSizeChars')
-                if device.get('imageSha256') is not None:
-                    response['imageSha256'] = device.get('imageSha256')
-            
-            print(f'📊 设备 {clean_id} 查询状态: claimed=True, imageVersion={image_version}')
-        else:
-            # 未绑定：生成或返回配对码
-            response['imageVersion'] = 0
-            
-            pairing_code = None
-            expires_at = None
-            
-            if pairing_codes_collection is not None:
-                pairing_doc = pairing_codes_collection.find_one({'deviceId': clean_id})
-                if pairing_doc:
-                    pairing_code = pairing_doc.get('code')
-                    expires_at = pairing_doc.get('expiresAt')
-            
-            if not pairing_code or (expires_at and expires_at < datetime.utcnow()):
-                import random
-                pairing_code = f"{random.randint(100000, 999999)}"
-                expires_at = datetime.utcnow() + timedelta(hours=24)
-                
-                if pairing_codes_collection is not None:
-                    pairing_codes_collection.update_one(
-                        {'deviceId': clean_id},
-                        {
-                            '$set': {
-                                'code': pairing_code,
-                                'expiresAt': expires_at,
-                                'createdAt': datetime.utcnow()
-                            }
-                        },
-                        upsert=True
-                    )
-            
-            if expires_at:
-                expires_in = int((expires_at - datetime.utcnow()).total_seconds())
-                if expires_in < 0:
-                    expires_in = 0
-            else:
-                expires_in = 86400
-            
-            response['pairingCode'] = pairing_code
-            response['expiresIn'] = expires_in
-            
-            print(f'📊 设备 {clean_id} 查询状态: claimed=False, pairingCode={pairing_code}')
-        
         return jsonify(response)
     except Exception as e:
         print(f'❌ Error querying device status: {e}')
@@ -578,6 +1056,198 @@ def device_status():
         traceback.print_exc()
         return jsonify({'success': False, 'error': str(e)}), 500
 
+@app.route('/api/device/status/bin', methods=['POST'])
+def device_status_binary():
+    """二进制版 status（无需登录，设备调用），请求/响应格式见 epd_status.py
+
+    内容与 JSON 版相同，设备在栈上缓冲区里直接打包/解析；未绑定时配对码同样会生成，
+    设备只需要 claimed，不下发配对码
+    """
+    req = parse_status_request(request.get_data(cache=False))
+    if req is None:
+        return Response(status=400)
+    clean_id = normalize_device_id(req['deviceId'])
+    import re
+    if not re.match(r'^[0-9A-F]{6}$|^[0-9A-F]{12}$', clean_id):
+        return Response(status=400)
+
+    try:
+        result = build_device_status(clean_id, parse_device_formats(req['formats']),
+                                     req['baseVersion'], req['baseCrc'], req['timing'])
+        if result is None:
+            return Response(status=500)
+        body = build_status_response(result['claimed'], result.get('imageVersion', 0), result.get('imageUrl', ''),
+                                     result.get('imageFormat', EPD_FORMAT_TEXT), result.get('imageSize'),
+                                     result.get('imageSha256'))
+    except Exception as e:
+        print(f'❌ Error querying device status (binary): {e}')
+        return Response(status=500)
+    return Response(body, mimetype='application/octet-stream')
+
+@app.route('/api/device/<device_id>/image', methods=['GET'])
+def device_image_conditional(device_id):
+    """设备单次请求完成更新检查并下载（无需登录，设备调用）
+
+    常见的“没有新图片”的唤醒只需这一个请求，有新图片时在同一个连接里直接下载：
+    - If-None-Match: "v<设备当前版本>"，不低于最新版本时返回 304（无响应体）
+    - X-EPD-Formats: 支持的格式（逗号分隔，同 status 的 formats）
+    - X-EPD-Base: "<基准帧版本>:<基准帧CRC>"（设备支持差分且有基准帧时）
+    - X-EPD-Timing: 之前几次唤醒的分阶段耗时（同 status 的 timing）
+    返回 200 时响应体就是要下载的数据（与 status 选择的格式相同，可压缩），元数据在响应头：
+    ETag（"v<版本>"）、X-EPD-Version、X-EPD-Format、X-EPD-Bytes、X-EPD-SHA256，
+    X-EPD-Url 为同一数据的固定下载地址（断点续传时设备改用该地址）。
+    未绑定或没有图片时返回 204，设备改走 /api/device/status（显示配对码等）
+
+    设备带 X-EPD-Playlist-Max（支持播放列表）时，已绑定设备的响应都带 X-EPD-Playlist：
+    激活列表的清单标识 "l<listId>"（与 /playlist 的 ETag 相同，不一致时设备再去取清单），
+    没有激活的列表时为 none。有激活的列表时不下发单张图片，直接返回 304
+    """
+    clean_id = normalize_device_id(device_id)
+    import re
+    if not re.match(r'^[0-9A-F]{6}$|^[0-9A-F]{12}$', clean_id):
+        return jsonify({'success': False, 'error': 'Invalid deviceId format'}), 400
+
+    try:
+        touch_device_last_seen(clean_id)
+        store_wake_timing(clean_id, request.headers.get('X-EPD-Timing'))
+        if devices_collection is None:
+            return jsonify({'success': False, 'error': 'Database not connected'}), 500
+        device = devices_collection.find_one({'deviceId': clean_id})
+    except Exception as e:
+        print(f'❌ Error querying device image: {e}')
+        return jsonify({'success': False, 'error': str(e)}), 500
+
+    if device is None or not device.get('claimed', False):
+        return Response(status=204)
+
+    playlist_tag = None
+    if 'X-EPD-Playlist-Max' in request.headers:
+        try:
+            playlist = build_device_playlist(clean_id, parse_device_formats(request.headers.get('X-EPD-Formats')),
+                                             request.headers.get('X-EPD-Playlist-Max', type=int))
+        except Exception as e:
+            print(f'❌ Error building playlist: {e}')
+            return jsonify({'success': False, 'error': str(e)}), 500
+        if playlist is not None:
+            resp = Response(status=304)
+            resp.headers['X-EPD-Playlist'] = f'"l{playlist[1]}"'
+            return resp
+        playlist_tag = 'none'
+
+    image_version = device.get('imageVersion', 0)
+    etag = f'v{image_version}'
+    client_version = None
+    for tag in request.if_none_match.as_set():
+        if tag.startswith('v') and tag[1:].isdigit():
+            client_version = max(client_version or 0, int(tag[1:]))
+    # 设备版本高于云端（删除后重新添加设备，云端版本从 0 重新计数）时同样返回 304：
+    # 设备只接受更高的版本（与 status 流程一致），下发整帧只会被丢弃
+    if image_version > 0 and client_version is not None and client_version >= image_version:
+        resp = Response(status=304)
+        resp.set_etag(etag)
+        if playlist_tag:
+            resp.headers['X-EPD-Playlist'] = playlist_tag
+        return resp
+
+    base_version = base_crc = None
+    base = request.headers.get('X-EPD-Base', '')
+    if ':' in base:
+        try:
+            base_version, base_crc = (int(v) for v in base.split(':', 1))
+        except ValueError:
+            pass
+    download = select_device_download(clean_id, device, parse_device_formats(request.headers.get('X-EPD-Formats')),
+                                      base_version, base_crc)
+    if download is None:
+        resp = Response(status=204)
+        if playlist_tag:
+            resp.headers['X-EPD-Playlist'] = playlist_tag
+        return resp
+    sha256 = download['sha256'] or file_sha256(download['path'])
+
+    print(f'📥 ESP32条件下载: {clean_id} v{image_version} ({download["format"]}, {download["size"]} 字节)')
+    mimetype = 'text/plain' if download['format'] == EPD_FORMAT_TEXT else 'application/octet-stream'
+    resp = raw_file_response(download['path'], mimetype, sha256)
+    resp.set_etag(etag)
+    resp.headers['Cache-Control'] = 'no-cache'
+    resp.headers['X-EPD-Version'] = str(image_version)
+    resp.headers['X-EPD-Format'] = download['format']
+    resp.headers['X-EPD-Bytes'] = str(download['path'].stat().st_size)
+    resp.headers['X-EPD-SHA256'] = sha256
+    resp.headers['X-EPD-Url'] = download['url']
+    if playlist_tag:
+        resp.headers['X-EPD-Playlist'] = playlist_tag
+    return resp
+
+def build_device_playlist(clean_id: str, device_formats: set, max_pages):
+    """按激活的页面列表生成播放列表清单
+
+    返回 (清单, listId, 页数, 每页分钟数)；没有激活的列表或列表中没有可渲染的页面（模板页）时返回 None
+    """
+    if page_lists_collection is None or pages_collection is None:
+        return None
+    page_list = page_lists_collection.find_one({'deviceId': clean_id, 'isActive': True}, {'_id': 0})
+    if not page_list:
+        return None
+    max_pages = max(1, min(max_pages or EPD_PLAYLIST_DEFAULT_PAGES, PLAYLIST_MAX_PAGES))
+    entries = []
+    for item in page_list.get('pages') or []:
+        page_id = item.get('pageId') if isinstance(item, dict) else item
+        page = pages_collection.find_one({'pageId': page_id, 'deviceId': clean_id}) if page_id else None
+        entry = select_page_download(clean_id, page, device_formats) if page else None
+        if entry is not None:
+            entries.append(entry)
+        if len(entries) >= max_pages:
+            break
+    if not entries:
+        return None
+    interval = page_list.get('interval', 60)
+    body, list_id = build_playlist_manifest(interval, entries)
+    return body, list_id, len(entries), interval
+
+@app.route('/api/device/<device_id>/playlist', methods=['GET'])
+def device_playlist(device_id):
+    """设备取激活页面列表的清单（无需登录，设备调用），布局见 epd_playlist.py
+
+    设备把清单中的各页预取到帧分区，之后不联网轮流显示，只按较长的间隔再来检查清单：
+    - If-None-Match: "l<listId>"，清单未变时返回 304
+    - X-EPD-Formats: 支持的格式（同条件 GET；页面不下发差分帧）
+    - X-EPD-Playlist-Max: 设备最多缓存的页数（多出的页不下发）
+    - X-EPD-Timing: 之前几次唤醒的分阶段耗时（同条件 GET）
+    未绑定、没有激活的列表、或列表中没有可渲染的页面（模板页）时返回 204，设备按单张图片工作
+    """
+    clean_id = normalize_device_id(device_id)
+    if not re.match(r'^[0-9A-F]{6}$|^[0-9A-F]{12}$', clean_id):
+        return jsonify({'success': False, 'error': 'Invalid deviceId format'}), 400
+
+    try:
+        touch_device_last_seen(clean_id)
+        store_wake_timing(clean_id, request.headers.get('X-EPD-Timing'))
+        if devices_collection is None:
+            return jsonify({'success': False, 'error': 'Database not connected'}), 500
+        device = devices_collection.find_one({'deviceId': clean_id})
+        if device is None or not device.get('claimed', False):
+            return Response(status=204)
+        playlist = build_device_playlist(clean_id, parse_device_formats(request.headers.get('X-EPD-Formats')),
+                                         request.headers.get('X-EPD-Playlist-Max', type=int))
+        if playlist is None:
+            return Response(status=204)
+        body, list_id, count, interval = playlist
+    except Exception as e:
+        print(f'❌ Error building playlist: {e}')
+        return jsonify({'success': False, 'error': str(e)}), 500
+
+    etag = f'l{list_id}'
+    if request.if_none_match.contains(etag):
+        resp = Response(status=304)
+        resp.set_etag(etag)
+        return resp
+    print(f'📋 ESP32获取播放列表: {clean_id} {count} 页，每页 {interval} 分钟')
+    resp = Response(body, mimetype='application/octet-stream')
+    resp.set_etag(etag)
+    resp.headers['Cache-Control'] = 'no-cache'
+    return resp
+
 @app.route('/api/device/claim', methods=['POST'])
 @login_required
 def device_claim():
@@ -1245,9 +1915,17 @@ def epd_load():
     image_size_bytes = len(image_data.encode('utf-8'))
     image_sha256 = hashlib.sha256(image_data.encode('utf-8')).hexdigest()
 
-    # 持久化保存图片数据
+    # 同时生成各二进制帧（bin 下载量减半，rle 对纯色为主的画面再压缩数倍）
+    frames = {fmt: build(image_data, EPD_WIDTH, EPD_HEIGHT) for fmt, build in EPD_FRAME_BUILDERS.items()}
+    frames_meta = {fmt: {'size': len(frame), 'sha256': hashlib.sha256(frame).hexdigest()}
+                   for fmt, frame in frames.items()}
+
+    # 持久化保存图片数据（先写文本，再写帧，保证帧的 mtime 不早于文本）
     if not save_device_image(clean_id, image_data):
         return jsonify({'success': False, 'error': 'Failed to save image'}), 500
+    for fmt, frame in frames.items():
+        if not save_device_frame(clean_id, fmt, frame):
+            return jsonify({'success': False, 'error': 'Failed to save image'}), 500
     
     # 更新图片版本号（递增）
     if devices_collection is not None:
@@ -1263,14 +1941,18 @@ def epd_load():
                     'imageSizeChars': image_size_chars,
                     'imageSizeBytes': image_size_bytes,
                     'imageSha256': image_sha256,
+                    'imageFrames': frames_meta,
                     'updatedAt': datetime.utcnow()
                 }
             }
         )
         
+        save_frame_history(clean_id, new_version, frames[EPD_FORMAT_BIN])
+        
         print(f'✅ 图片已保存: {clean_id}, 版本: {current_version} -> {new_version} '
               f'(matched={result.matched_count}, modified={result.modified_count})')
         print(f'   数据大小: {len(image_data)} 字符 ({len(image_data)/1024:.2f} KB)')
+        print('   二进制帧: ' + ', '.join(f'{fmt} {meta["size"]} 字节' for fmt, meta in frames_meta.items()))
         print(f'   设备下次唤醒时将自动拉取更新')
         
         return jsonify({
@@ -1288,9 +1970,17 @@ def epd_load():
 def epd_raw_download(device_id):
     """下载设备的原始图片数据（ESP32通过HTTP下载）
     
-    返回 text/plain 格式的 a~p 编码字符串
+    默认返回 text/plain 格式的 a~p 编码字符串；
+    fmt=bin / fmt=rle 时返回 EPDF 二进制帧（application/octet-stream，见 epd_frame.py）；
+    fmt=delta&base=<版本> 时返回 status 中生成的差分帧（v 为目标版本）
     """
     clean_id = normalize_device_id(device_id)
+
+    fmt = (request.args.get('fmt') or '').lower()
+    if fmt in EPD_FRAME_BUILDERS:
+        return epd_raw_download_frame(clean_id, fmt)
+    if fmt == EPD_FORMAT_DELTA:
+        return epd_raw_download_delta(clean_id, request.args.get('base', type=int), request.args.get('v', type=int))
     
     image_path = get_device_image_path(clean_id)
     if not image_path.exists():
@@ -1304,33 +1994,110 @@ def epd_raw_download(device_id):
     if data_size_bytes != EPD_EXPECTED_CHARS:
         print(f'⚠️  数据大小不匹配: 期望 {EPD_EXPECTED_CHARS}, 实际 {data_size_bytes}（磁盘文件可能异常）')
 
-    # 用 send_file 直接流式发送文件，减少内存占用，并提供条件请求/ETag（更利于代理/断点续传扩展）
-    resp = send_file(
-        image_path,
-        mimetype='text/plain',
-        conditional=True,
-        etag=True,
-        max_age=0
-    )
+    # 如果 DB 里有 hash 就直接用，没有则现算（兼容旧数据）
+    d = None
+    try:
+        if devices_collection is not None:
+            d = devices_collection.find_one({'deviceId': clean_id}, {'_id': 0, 'imageSha256': 1, 'imageSizeChars': 1})
+    except Exception:
+        pass
+    image_sha256 = (d or {}).get('imageSha256') or file_sha256(image_path)
+
+    # 客户端支持时压缩传输（a~p 文本压缩率很高）；否则用 send_file 直接流式发送文件，
+    # 减少内存占用，并提供条件请求/ETag/Range（设备断点续传）
+    resp = raw_file_response(image_path, 'text/plain', image_sha256)
     resp.headers['Content-Type'] = 'text/plain; charset=utf-8'
     resp.headers['Cache-Control'] = 'no-cache, no-store, must-revalidate'
     resp.headers['Pragma'] = 'no-cache'
     resp.headers['Expires'] = '0'
-    resp.headers['Accept-Ranges'] = 'bytes'
     resp.headers['X-EPD-Expected-Chars'] = str(EPD_EXPECTED_CHARS)
+    resp.headers['X-EPD-Format'] = EPD_FORMAT_TEXT
+    resp.headers['X-EPD-SHA256'] = image_sha256
+    if d and d.get('imageSizeChars') is not None:
+        resp.headers['X-EPD-Chars'] = str(d['imageSizeChars'])
+
+    return resp
+
+def epd_raw_download_frame(clean_id: str, fmt: str):
+    """下载二进制帧（epd_raw_download 在 fmt=bin/rle 时调用）"""
+    frame_path = ensure_device_frame(clean_id, fmt)
+    if frame_path is None:
+        print(f'❌ 二进制帧不存在: {clean_id}')
+        return jsonify({'error': 'Image not found'}), 404
+
+    frame_size = frame_path.stat().st_size
+    print(f'📥 ESP32下载二进制帧: {clean_id} ({fmt}, {frame_size} 字节)')
 
-    # 如果 DB 里有 hash，就带上；没有也不强制（兼容旧数据）
+    # 哈希是二进制帧本身的（与 status 返回的 imageSha256 一致）
+    d = None
     try:
         if devices_collection is not None:
-            d = devices_collection.find_one({'deviceId': clean_id}, {'_id': 0, 'imageSha256': 1, 'imageSizeChars': 1})
-            if d:
-                if d.get('imageSha256'):
-                    resp.headers['X-EPD-SHA256'] = d['imageSha256']
-                if d.get('imageSizeChars') is not None:
-                    resp.headers['X-EPD-Chars'] = str(d['imageSizeChars'])
+            d = devices_collection.find_one({'deviceId': clean_id}, {'_id': 0, 'imageFrames': 1})
     except Exception:
         pass
+    frame_sha256 = get_frame_sha256(d, fmt, frame_path)
+
+    resp = raw_file_response(frame_path, 'application/octet-stream', frame_sha256)
+    resp.headers['Cache-Control'] = 'no-cache, no-store, must-revalidate'
+    resp.headers['Pragma'] = 'no-cache'
+    resp.headers['Expires'] = '0'
+    resp.headers['X-EPD-Format'] = fmt
+    resp.headers['X-EPD-Bytes'] = str(frame_size)
+    resp.headers['X-EPD-SHA256'] = frame_sha256
+
+    return resp
 
+def epd_raw_download_delta(clean_id: str, base_version, target_version):
+    """下载差分帧（只提供 status 已生成的缓存；期间有新发布时缓存已清除，返回 404 让设备重新查询）"""
+    if base_version is None or target_version is None:
+        return jsonify({'error': 'Missing base or v'}), 400
+    delta_path = get_device_delta_path(clean_id, base_version, target_version)
+    if not delta_path.exists():
+        print(f'❌ 差分帧不存在: {clean_id} v{base_version} -> v{target_version}')
+        return jsonify({'error': 'Delta not found'}), 404
+
+    delta_size = delta_path.stat().st_size
+    print(f'📥 ESP32下载差分帧: {clean_id} v{base_version} -> v{target_version} ({delta_size} 字节)')
+
+    delta_sha256 = file_sha256(delta_path)
+    resp = raw_file_response(delta_path, 'application/octet-stream', delta_sha256)
+    resp.headers['Cache-Control'] = 'no-cache, no-store, must-revalidate'
+    resp.headers['Pragma'] = 'no-cache'
+    resp.headers['Expires'] = '0'
+    resp.headers['X-EPD-Format'] = EPD_FORMAT_DELTA
+    resp.headers['X-EPD-Bytes'] = str(delta_size)
+    resp.headers['X-EPD-SHA256'] = delta_sha256
+    return resp
+
+@app.route('/api/epd/page/<device_id>/<page_id>', methods=['GET'])
+def epd_page_download(device_id, page_id):
+    """下载播放列表中一页渲染出的数据（设备预取用，数据由 playlist 清单生成）
+
+    fmt 同 /api/epd/raw（text/bin/rle），h 是内容哈希的前缀，只用于区分页面修改前后的地址
+    """
+    clean_id = normalize_device_id(device_id)
+    # 先校验设备码再碰文件系统（get_device_data_dir 会创建目录）
+    if not re.match(r'^[0-9A-F]{6}$|^[0-9A-F]{12}$', clean_id):
+        return jsonify({'success': False, 'error': 'Invalid deviceId format'}), 400
+    fmt = (request.args.get('fmt') or EPD_FORMAT_TEXT).lower()
+    if (fmt != EPD_FORMAT_TEXT and fmt not in EPD_FRAME_BUILDERS) or not re.match(r'^[0-9A-Za-z_-]{1,64}$', page_id):
+        return jsonify({'error': 'Invalid page or fmt'}), 400
+    path = get_page_frame_path(clean_id, page_id, fmt)
+    if not path.exists():
+        print(f'❌ 页面数据不存在: {clean_id}/{page_id} ({fmt})')
+        return jsonify({'error': 'Page not found'}), 404
+
+    size = path.stat().st_size
+    print(f'📥 ESP32下载页面: {clean_id}/{page_id} ({fmt}, {size} 字节)')
+    sha256 = file_sha256(path)
+    mimetype = 'text/plain' if fmt == EPD_FORMAT_TEXT else 'application/octet-stream'
+    resp = raw_file_response(path, mimetype, sha256)
+    resp.headers['Cache-Control'] = 'no-cache, no-store, must-revalidate'
+    resp.headers['Pragma'] = 'no-cache'
+    resp.headers['Expires'] = '0'
+    resp.headers['X-EPD-Format'] = fmt
+    resp.headers['X-EPD-Bytes'] = str(size)
+    resp.headers['X-EPD-SHA256'] = sha256
     return resp
 
 @app.route('/api/epd/show', methods=['POST'])
@@ -62,6 +62,14 @@ def create_indexes():
             device_status_collection.create_index('deviceId', unique=True, name='deviceId_unique')
             print('✅ 创建索引: device_status.deviceId (unique)')
         
+        # 4. wake_timings集合索引（设备上报的唤醒耗时，重复上报按 deviceId+bootId+seq 去重，30 天后过期）
+        wake_timings_collection = db['wake_timings']
+        # 不指定索引名：与 app.py 启动时创建的索引同名，重复执行不会冲突
+        wake_timings_collection.create_index([('deviceId', 1), ('bootId', 1), ('seq', 1)], unique=True)
+        print('✅ 创建索引: wake_timings.deviceId+bootId+seq (unique)')
+        wake_timings_collection.create_index('receivedAt', expireAfterSeconds=30 * 24 * 3600)
+        print('✅ 创建TTL索引: wake_timings.receivedAt (30天过期)')
+        
         print('\n✅ 所有索引创建完成！')
         
         # 显示所有索引
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+EPD 二进制帧格式（EPDF）
+
+设备下载的图片原先是 a~p 文本编码（每像素一个字符，800x480 共 384000 字符），
+二进制帧直接传输打包好的 4bit 像素（每字节两个像素，共 192000 字节），传输量减半。
+
+帧布局（小端）：
+    偏移  长度  字段
+    0     4     magic        b'EPDF'
+    4     1     version      格式版本（当前为 1）
+    5     1     pixelFormat  像素格式（1 = 4bit 打包，与 EPD_7IN3E 显存一致；2 = 按行 RLE）
+    6     2     width        像素宽度
+    8     2     height       像素高度
+    10    2     headerLen    头部长度（payload 起始偏移，便于以后扩展头部）
+    12    4     payloadLen   payload 字节数
+    16    4     crc32        payload 的 CRC32（与 zlib.crc32 / esp_rom_crc32_le 一致）
+
+RLE（pixelFormat = 2）按行编码，每行解码后正好是 width/2 字节，行与行互相独立：
+    行 = u16 本行编码长度（小端） + 若干 token
+    0x00~0x3F  字面量：后跟 (t+1) 个原样字节
+    0x40~0x7F  通用重复：后跟 1 个字节值，重复 (t&0x3F)+3 次
+    0x80~0xFF  纯色：1ccc nnnn，字节值为 ccc 重复到两个像素（E6 颜色索引都小于 8），
+               重复 nnnn+1 次；nnnn == 0xF 时再跟 1 个字节 k，重复 16+k 次
+E6 只用 6 种颜色且大面积纯色，纯色 token 一个字节就能覆盖一整段。
+
+差分（pixelFormat = 3）相对设备保存的基准帧（PIXFMT_BIN4）只传变化的行：
+    u32 baseCrc     基准帧 payload 的 CRC32（设备据此确认基准帧一致）
+    u32 targetCrc   打补丁后结果帧 payload 的 CRC32
+    u16 rangeCount
+    每段：u16 rowStart, u16 rowCount, 然后 rowCount 行 BIN4 数据
+
+设备端解析见固件 epd_frame.h，两边字段必须保持一致。
+"""
+
+from __future__ import annotations
+
+import struct
+import zlib
+from typing import Optional
+
+FRAME_MAGIC = b'EPDF'
+FRAME_VERSION = 1
+FRAME_HEADER = struct.Struct('<4sBBHHHII')
+FRAME_HEADER_SIZE = FRAME_HEADER.size  # 20
+
+# 像素格式
+PIXFMT_BIN4 = 1  # 每字节两个像素，字节值与文本编码的字符对解码结果相同，可直接写入显存
+PIXFMT_RLE4 = 2  # PIXFMT_BIN4 按行 RLE 压缩
+PIXFMT_DELTA4 = 3  # 相对基准帧的变化行
+
+DELTA_PREFIX = struct.Struct('<IIH')
+DELTA_RANGE = struct.Struct('<HH')
+
+# RLE token
+RLE_LITERAL_MAX = 64          # 0x00~0x3F
+RLE_RUN_MIN = 3               # 0x40~0x7F: 3~66
+RLE_RUN_MAX = RLE_RUN_MIN + 0x3F
+RLE_SOLID_SHORT_MAX = 15      # 0x80~0xFF, nnnn 0~14: 1~15
+RLE_SOLID_MAX = 16 + 0xFF     # nnnn == 0xF + 扩展字节: 16~271
+
+# 文本编码：每字节两个字符，第1个字符为低4bit，第2个字符为高4bit，'a'=0 ... 'p'=15
+_LOW_NIBBLE = bytes.maketrans(b'abcdefghijklmnop', bytes(range(16)))
+_HIGH_NIBBLE = bytes.maketrans(b'abcdefghijklmnop', bytes(v << 4 for v in range(16)))
+
+
+def text_to_packed(image_data: str) -> bytes:
+    """把 a~p 文本编码转换为 4bit 打包字节（调用方需先做字符集/长度校验）"""
+    raw = image_data.encode('ascii')
+    low = raw[0::2].translate(_LOW_NIBBLE)
+    high = raw[1::2].translate(_HIGH_NIBBLE)
+    # 两段互不重叠的 bit 直接按大整数做或运算，避免 19 万次 Python 循环
+    n = len(low)
+    return (int.from_bytes(low, 'big') | int.from_bytes(high, 'big')).to_bytes(n, 'big')
+
+
+def build_frame(payload: bytes, width: int, height: int, pixel_format: int = PIXFMT_BIN4) -> bytes:
+    """给 payload 加上 EPDF 头部"""
+    header = FRAME_HEADER.pack(
+        FRAME_MAGIC,
+        FRAME_VERSION,
+        pixel_format,
+        width,
+        height,
+        FRAME_HEADER_SIZE,
+        len(payload),
+        zlib.crc32(payload) & 0xFFFFFFFF,
+    )
+    return header + payload
+
+
+def build_bin4_frame(image_data: str, width: int, height: int) -> bytes:
+    """a~p 文本编码 -> 完整的 EPDF 4bit 帧"""
+    return build_frame(text_to_packed(image_data), width, height, PIXFMT_BIN4)
+
+
+def _is_solid(value: int) -> bool:
+    """两个像素同色且颜色索引可用 3bit 表示"""
+    return (value >> 4) == (value & 0x0F) and value < 0x80
+
+
+def rle_encode_row(row: bytes) -> bytes:
+    """编码一行（不含行长度前缀）"""
+    out = bytearray()
+    literal = bytearray()
+
+    def flush_literal():
+        for k in range(0, len(literal), RLE_LITERAL_MAX):
+            chunk = literal[k:k + RLE_LITERAL_MAX]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+        literal.clear()
+
+    i = 0
+    n = len(row)
+    while i < n:
+        value = row[i]
+        j = i + 1
+        while j < n and row[j] == value:
+            j += 1
+        run = j - i
+
+        if _is_solid(value) and (run >= 2 or not literal):
+            # 纯色 token 只占 1 字节；但夹在字面量中间的单个纯色字节留在字面量里，
+            # 否则要多付一个新字面量 token，最坏情况超过 EPD_RLE_MAX_ROW
+            flush_literal()
+            color = value & 0x07
+            while run > 0:
+                count = min(run, RLE_SOLID_MAX)
+                if count <= RLE_SOLID_SHORT_MAX:
+                    out.append(0x80 | (color << 4) | (count - 1))
+                else:
+                    out.append(0x80 | (color << 4) | 0x0F)
+                    out.append(count - 16)
+                run -= count
+        elif run >= RLE_RUN_MIN:
+            flush_literal()
+            while run >= RLE_RUN_MIN:
+                count = min(run, RLE_RUN_MAX)
+                out.append(0x40 | (count - RLE_RUN_MIN))
+                out.append(value)
+                run -= count
+            literal.extend(row[j - run:j])
+        else:
+            literal.extend(row[i:j])
+        i = j
+
+    flush_literal()
+    return bytes(out)
+
+
+def rle_encode_rows(packed: bytes, row_bytes: int) -> bytes:
+    """按行编码整帧：每行 u16 长度前缀 + token"""
+    out = bytearray()
+    for offset in range(0, len(packed), row_bytes):
+        encoded = rle_encode_row(packed[offset:offset + row_bytes])
+        out.extend(struct.pack('<H', len(encoded)))
+        out.extend(encoded)
+    return bytes(out)
+
+
+def build_rle4_frame(image_data: str, width: int, height: int) -> bytes:
+    """a~p 文本编码 -> 完整的 EPDF RLE 帧"""
+    row_bytes = (width + 1) // 2
+    return build_frame(rle_encode_rows(text_to_packed(image_data), row_bytes), width, height, PIXFMT_RLE4)
+
+
+def frame_payload(frame: bytes, header: dict) -> bytes:
+    """取出帧的 payload"""
+    start = header['headerLen']
+    return frame[start:start + header['payloadLen']]
+
+
+def build_delta_frame(base_frame: bytes, target_frame: bytes) -> Optional[bytes]:
+    """两个 BIN4 帧 -> 差分帧（相邻的变化行合并为一段）
+
+    尺寸/格式不一致，或差分不比完整帧小时返回 None（调用方改为下发完整帧）
+    """
+    base = parse_frame_header(base_frame)
+    target = parse_frame_header(target_frame)
+    if base is None or target is None:
+        return None
+    if base['pixelFormat'] != PIXFMT_BIN4 or target['pixelFormat'] != PIXFMT_BIN4:
+        return None
+    if (base['width'], base['height']) != (target['width'], target['height']):
+        return None
+
+    width, height = target['width'], target['height']
+    row_bytes = (width + 1) // 2
+    old = frame_payload(base_frame, base)
+    new = frame_payload(target_frame, target)
+
+    ranges = []
+    for row in range(height):
+        offset = row * row_bytes
+        if old[offset:offset + row_bytes] == new[offset:offset + row_bytes]:
+            continue
+        if ranges and ranges[-1][0] + ranges[-1][1] == row:
+            ranges[-1][1] += 1
+        else:
+            ranges.append([row, 1])
+
+    payload = bytearray(DELTA_PREFIX.pack(base['crc32'], target['crc32'], len(ranges)))
+    for start, count in ranges:
+        payload.extend(DELTA_RANGE.pack(start, count))
+        payload.extend(new[start * row_bytes:(start + count) * row_bytes])
+
+    frame = build_frame(bytes(payload), width, height, PIXFMT_DELTA4)
+    return frame if len(frame) < len(target_frame) else None
+
+
+def parse_frame_header(data: bytes) -> Optional[dict]:
+    """解析 EPDF 头部，格式不对返回 None"""
+    if len(data) < FRAME_HEADER_SIZE:
+        return None
+    magic, version, pixel_format, width, height, header_len, payload_len, crc = FRAME_HEADER.unpack_from(data)
+    if magic != FRAME_MAGIC or header_len < FRAME_HEADER_SIZE:
+        return None
+    return {
+        'version': version,
+        'pixelFormat': pixel_format,
+        'width': width,
+        'height': height,
+        'headerLen': header_len,
+        'payloadLen': payload_len,
+        'crc32': crc,
+    }
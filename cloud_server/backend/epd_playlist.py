@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+播放列表清单（GET /api/device/<deviceId>/playlist）
+
+设备一次取回激活的页面列表中各页的下载地址、大小和 SHA-256，把各页预取到帧分区，
+之后定时唤醒和短按时不联网轮流显示，只按较长的间隔重新检查清单（If-None-Match: "l<listId>"）。
+
+布局（小端）：
+    偏移  长度  字段
+    0     4     magic        b'EPDL'
+    4     1     version      协议版本（当前为 1）
+    5     1     count        页数
+    6     2     interval     每页显示时长（分钟）
+    8     4     listId       清单标识（条目内容的 CRC32，不为 0），同时用作 ETag
+    12          count 个条目，每个条目：
+        0     1     format   编号同 status（0=text 1=bin 2=rle）
+        1     1     urlLen
+        2     2     reserved
+        4     4     size     url 对应数据的字节数
+        8     32    sha256   url 对应数据的 SHA-256（原始字节）
+        40    n     url      ASCII，不含结尾 0
+
+设备端解析见固件 epd_playlist.h，两边字段必须保持一致。
+"""
+
+from __future__ import annotations
+
+import struct
+import zlib
+
+from epd_status import STATUS_FORMATS
+
+PLAYLIST_MAGIC = b'EPDL'
+PLAYLIST_VERSION = 1
+PLAYLIST_HEADER = struct.Struct('<4sBBHI')
+PLAYLIST_ENTRY = struct.Struct('<BBHI32s')
+PLAYLIST_MAX_URL = 255
+PLAYLIST_MAX_PAGES = 16
+
+
+def build_playlist_manifest(interval_minutes: int, entries) -> tuple[bytes, int]:
+    """打包清单，entries 为 [{format, size, sha256, url}]（sha256 为十六进制）
+
+    返回 (清单, listId)；listId 只取决于条目和显示时长，页面没有变化时保持不变
+    """
+    if len(entries) > PLAYLIST_MAX_PAGES:
+        raise ValueError(f'页数超过 {PLAYLIST_MAX_PAGES}')
+    interval = max(1, min(int(interval_minutes or 0), 0xFFFF))
+    body = b''
+    for entry in entries:
+        url = entry['url'].encode('ascii')
+        if len(url) > PLAYLIST_MAX_URL:
+            raise ValueError(f'url 超过 {PLAYLIST_MAX_URL} 字节')
+        fmt = STATUS_FORMATS.index(entry['format'])
+        body += PLAYLIST_ENTRY.pack(fmt, len(url), 0, int(entry['size']), bytes.fromhex(entry['sha256'])) + url
+    list_id = zlib.crc32(struct.pack('<H', interval) + body) or 1
+    header = PLAYLIST_HEADER.pack(PLAYLIST_MAGIC, PLAYLIST_VERSION, len(entries), interval, list_id)
+    return header + body, list_id
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+二进制 status 协议（POST /api/device/status/bin）
+
+JSON 版 /api/device/status 需要设备拼字符串、序列化和解析 JSON；二进制版请求和响应
+都是定长头部 + 变长尾部，设备在栈上缓冲区里直接打包/解析。两种接口返回的内容相同。
+
+请求布局（小端）：
+    偏移  长度  字段
+    0     4     magic        b'EPDS'
+    4     1     version      协议版本（当前为 1）
+    5     1     formats      支持的格式，位 1<<n（n: 0=text 1=bin 2=rle 3=delta）
+    6     2     timingLen    timing 字节数
+    8     4     baseVersion  基准帧版本（0 = 没有基准帧）
+    12    4     baseCrc      基准帧 payload 的 CRC32
+    16    12    deviceId     ASCII，不足补 0
+    28    n     timing       唤醒耗时记录（与 JSON 的 timing 字段相同的紧凑文本）
+
+响应布局（小端）：
+    0     4     magic        b'EPDS'
+    4     1     version
+    5     1     flags        0x01 已绑定  0x02 有图片（url/format 有效）  0x04 sha256 有效
+    6     1     format       下发格式（编号同请求 formats 的位号）
+    7     1     urlLen
+    8     4     imageVersion
+    12    4     imageSize    url 对应数据的字节数（0 = 未知）
+    16    32    sha256       url 对应数据的 SHA-256（原始字节）
+    48    n     url          ASCII，不含结尾 0
+
+设备端解析见固件 epd_status.h，两边字段必须保持一致。
+"""
+
+from __future__ import annotations
+
+import struct
+from typing import Optional
+
+STATUS_MAGIC = b'EPDS'
+STATUS_VERSION = 1
+STATUS_REQUEST = struct.Struct('<4sBBHII12s')
+STATUS_RESPONSE = struct.Struct('<4sBBBBII32s')
+STATUS_MAX_URL = 255
+STATUS_MAX_TIMING = 640
+
+STATUS_FLAG_CLAIMED = 0x01
+STATUS_FLAG_HAS_IMAGE = 0x02
+STATUS_FLAG_HAS_SHA = 0x04
+
+# 格式编号（设备端 EPD_FORMAT_*）
+STATUS_FORMATS = ['text', 'bin', 'rle', 'delta']
+
+
+def parse_status_request(data: bytes) -> Optional[dict]:
+    """解析请求，返回 {deviceId, formats, baseVersion, baseCrc, timing}；格式不对时返回 None"""
+    if len(data) < STATUS_REQUEST.size:
+        return None
+    magic, version, mask, timing_len, base_version, base_crc, device_id = STATUS_REQUEST.unpack_from(data)
+    if magic != STATUS_MAGIC or version != STATUS_VERSION:
+        return None
+    if timing_len > STATUS_MAX_TIMING or len(data) != STATUS_REQUEST.size + timing_len:
+        return None
+    try:
+        device_id = device_id.rstrip(b'\0').decode('ascii')
+        timing = data[STATUS_REQUEST.size:].decode('ascii')
+    except UnicodeDecodeError:
+        return None
+    return {
+        'deviceId': device_id,
+        'formats': [name for bit, name in enumerate(STATUS_FORMATS) if mask & (1 << bit)],
+        'baseVersion': base_version if base_version > 0 else None,
+        'baseCrc': base_crc if base_version > 0 else None,
+        'timing': timing,
+    }
+
+
+def build_status_response(claimed: bool, image_version: int, image_url: str = '', image_format: str = 'text',
+                          image_size: Optional[int] = None, image_sha256: Optional[str] = None) -> bytes:
+    """打包响应；image_url 为空表示没有可下载的图片"""
+    flags = STATUS_FLAG_CLAIMED if claimed else 0
+    url = (image_url or '').encode('ascii')
+    if len(url) > STATUS_MAX_URL:
+        raise ValueError(f'imageUrl 超过 {STATUS_MAX_URL} 字节')
+    if url:
+        flags |= STATUS_FLAG_HAS_IMAGE
+    sha = b'\0' * 32
+    if image_sha256 and len(image_sha256) == 64:
+        sha = bytes.fromhex(image_sha256)
+        flags |= STATUS_FLAG_HAS_SHA
+    fmt = STATUS_FORMATS.index(image_format) if image_format in STATUS_FORMATS else 0
+    return STATUS_RESPONSE.pack(STATUS_MAGIC, STATUS_VERSION, flags, fmt, len(url),
+                                max(int(image_version or 0), 0), int(image_size or 0), sha) + url
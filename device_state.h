@@ -0,0 +1,254 @@
+/**
+  ******************************************************************************
+  * @file    device_state.h
+  * @brief   跨深睡保持的设备状态：RTC 内存中的数据集中在一个结构体 g_devState 里，整体带 CRC
+  *          （绑定状态、图片版本、帧分区各槽的内容、播放列表、WiFi 配置、快速重连缓存、
+  *          刷新/续传的重试状态、唤醒耗时记录）
+  *
+  *          冷启动（上电、复位、刷机，或 CRC 不符）时从 NVS 载入一次需要持久化的字段，其余清零；
+  *          深睡唤醒时 CRC 有效，直接使用 RTC 中的副本，不打开 NVS。
+  *          持久化字段只在值变化时写回 NVS，同时更新 RTC 副本。
+  *
+  *          进入深睡前调用 deviceStateSeal() 重新计算 CRC。配网后 ESP.restart()、异常复位等
+  *          途径不更新 CRC，下次启动按冷启动处理，以 NVS 为准
+  ******************************************************************************
+  */
+
+#ifndef DEVICE_STATE_H
+#define DEVICE_STATE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <stddef.h>
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+
+/* NVS 配置（设备状态） */
+#define PREF_NAMESPACE "device"
+#define PREF_KEY_CLAIMED "claimed"
+#define PREF_KEY_IMG_VER "imgVer"
+#define PREF_KEY_FRAMES "frames"      // 帧分区槽表（FrameTable）
+#define PREF_KEY_PLAYLIST "playlist"  // 播放列表（PlaylistTable）
+
+/* NVS 配置（WiFi） */
+#define CONFIG_NAMESPACE "wifi_cfg"   // Preferences命名空间
+#define CONFIG_SSID_KEY "ssid"        // WiFi SSID存储键
+#define CONFIG_PASSWORD_KEY "pwd"     // WiFi密码存储键
+#define CONFIG_CONFIGURED_KEY "cfg"   // 配网标志位存储键
+#define CONFIG_FAST_KEY "fast"        // 快速重连缓存（BSSID/信道/IP）存储键
+
+#define DEVICE_STATE_MAGIC 0x44535431UL  // "DST1"
+
+extern Preferences preferences;  // 在Loader_esp32wf.ino中定义
+
+// 唤醒阶段编号（上报时的列顺序，云端按同样顺序解析；只能在末尾追加），见 wake_timing.h
+enum WakePhase {
+    WAKE_PHASE_BOOT = 0,     // 上电/唤醒到开始连 WiFi（含长按检测）
+    WAKE_PHASE_WIFI,         // WiFi 连接
+    WAKE_PHASE_STATUS,       // 更新检查（条件 GET / status 的请求和响应头）
+    WAKE_PHASE_DOWNLOAD,     // 接收响应体（直写屏幕模式下含解码）
+    WAKE_PHASE_DECODE,       // 从Flash读取、解码并写入屏幕显存
+    WAKE_PHASE_PANEL_INIT,   // 屏幕复位 + 初始化
+    WAKE_PHASE_REFRESH,      // 等待刷新（深睡等待刷新时为检查 BUSY 的追加唤醒）
+    WAKE_PHASE_SLEEP_PREP,   // 关 WiFi、配置唤醒源
+    WAKE_PHASE_COUNT
+};
+
+#define WAKE_TIMING_HISTORY 8
+
+typedef struct {
+    uint16_t seq;                          // 唤醒序号（bootId 相同的记录内递增）
+    uint8_t cause;                         // esp_sleep_get_wakeup_cause()
+    uint8_t uploaded;                      // 已上报到云端
+    uint32_t totalMs;                      // 本次唤醒的清醒时间
+    uint16_t phaseMs[WAKE_PHASE_COUNT];    // 各阶段毫秒（超过 65535 记为 65535）
+} WakeTimingRecord;
+
+/* 唤醒耗时环形记录（冷启动后重新生成 bootId，云端据此区分序号） */
+typedef struct {
+    uint32_t magic;
+    uint32_t bootId;
+    uint16_t nextSeq;
+    uint8_t head;      // 下一条记录写入的位置
+    uint8_t count;     // 有效记录数
+    WakeTimingRecord rec[WAKE_TIMING_HISTORY];
+} WakeTimingRing;
+
+/* 快速重连缓存（NVS 中存一份，冷启动时恢复），见 wifi_config.h */
+struct WiFiFastCache {
+    uint32_t magic;
+    uint32_t credCrc;    // SSID + 密码的 CRC，配网信息变化后缓存失效
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reuse;       // 静态地址已连续使用的次数（WIFI_FAST_REUSE_EXPIRED = 先走一次 DHCP）
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+#define WIFI_FAST_REUSE_EXPIRED 0xFF
+
+/* 帧分区（frames）中一个槽的内容，见 frame_store.h */
+#define FRAME_SLOT_MAX 8
+#define FRAME_SLOT_NONE 0xFF
+
+typedef struct {
+    int32_t version;   // 图片版本（0 = 空槽，PLAYLIST_FRAME_VERSION = 播放列表的页）
+    uint32_t size;     // 数据字节数
+    uint32_t crc;      // EPDF 帧头中的 payload CRC32（文本帧为 0）
+    uint8_t format;    // EPD_FORMAT_*（差分帧打补丁后按 bin 帧保存）
+    uint8_t reserved[3];
+    uint8_t sha256[32];  // 数据的 SHA-256（与 version 一起标识槽的内容，离线重显前校验）
+} FrameSlot;
+
+typedef struct {
+    uint8_t current;   // 当前显示的帧所在的槽（FRAME_SLOT_NONE = 没有）
+    uint8_t base;      // 差分基准帧（CRC 校验通过的 bin 帧）所在的槽，可以与 current 相同
+    uint8_t stale;     // 1 = 屏幕上不是 current 的画面（显示过设备码，或刷新未确认完成）
+    uint8_t dirty;     // 1 = 槽表写回 NVS 失败，NVS 中仍是旧表（只在 RTC 中有意义，写入 NVS 的总是 0）
+    FrameSlot slot[FRAME_SLOT_MAX];
+} FrameTable;
+
+/* 播放列表：激活的页面列表预取到帧分区的各页，见 http_update.h */
+#define PLAYLIST_MAX_PAGES 4
+#define PLAYLIST_FRAME_VERSION (-1)
+
+typedef struct {
+    uint32_t listId;        // 云端清单标识（ETag），0 = 下次联网时重新获取（上次预取不完整或有页损坏）
+    uint16_t intervalMin;   // 每页显示时长（分钟），也是播放列表模式下的定时唤醒间隔
+    uint8_t count;          // 页数（0 = 没有播放列表，按单张图片工作）
+    uint8_t reserved;
+    uint8_t slot[PLAYLIST_MAX_PAGES];  // 各页所在的帧槽，按显示顺序
+} PlaylistTable;
+
+/* 播放位置（只在 RTC 中，冷启动后清零） */
+typedef struct {
+    uint8_t index;          // 正在显示第几页
+    uint8_t reserved[3];
+    uint32_t sinceCheckMin; // 上次检查清单后定时唤醒累计的分钟数（按键唤醒不计）
+} PlaylistCursor;
+
+/* 刷新进行中深睡时的待完成工作（冷启动后无效），见 http_update.h */
+typedef struct {
+    uint32_t magic;    // EPD_REFRESH_PENDING_MAGIC 表示有待完成的刷新
+    int32_t version;   // 刷新完成后要提交的图片版本
+    uint16_t polls;    // 已经因 BUSY 仍为忙而追加唤醒的次数
+    uint8_t settled;   // 1 = 刷新已完成，只是版本号没能写入 NVS，下次唤醒重试提交
+    uint8_t reserved;
+} EpdPendingRefresh;
+
+/* 未下载完的数据的续传信息（冷启动后无效，已写入的部分随之作废），见 http_update.h */
+typedef struct {
+    uint32_t magic;    // EPD_RESUME_MAGIC 表示 slot 中是可续传的部分数据
+    uint32_t urlCrc;   // 下载URL的CRC32（URL 带版本号和格式，变化即放弃续传）
+    int32_t offset;    // 已保存的字节数
+    uint8_t slot;      // 部分数据所在的帧槽
+    char etag[72];     // 响应头 X-EPD-Resume-ETag（含引号），续传时作 If-Range
+} EpdResumeState;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t size;                 // sizeof(DeviceState)，结构体变化（刷了新固件）时按冷启动处理
+    /* 持久化字段（NVS 的副本） */
+    uint8_t claimed;               // PREF_KEY_CLAIMED
+    uint8_t wifiConfigured;        // CONFIG_CONFIGURED_KEY（且 SSID 非空）
+    int32_t imageVersion;          // PREF_KEY_IMG_VER
+    FrameTable frames;             // PREF_KEY_FRAMES
+    PlaylistTable playlist;        // PREF_KEY_PLAYLIST
+    char ssid[33];                 // CONFIG_SSID_KEY
+    char password[65];             // CONFIG_PASSWORD_KEY
+    WiFiFastCache wifi;            // CONFIG_FAST_KEY（reuse 只在 RTC 中累计）
+    /* 只在 RTC 中的字段 */
+    EpdPendingRefresh pendingRefresh;
+    EpdResumeState resume;
+    PlaylistCursor playlistCursor;
+    WakeTimingRing timing;
+    uint32_t crc;                  // 以上所有字节的 CRC32（deviceStateSeal 计算）
+} DeviceState;
+RTC_DATA_ATTR static DeviceState g_devState;
+
+/* 各模块沿用原来的名字访问各自的部分 */
+static WiFiFastCache &g_wifiCache = g_devState.wifi;
+static EpdPendingRefresh &g_pendingRefresh = g_devState.pendingRefresh;
+static EpdResumeState &g_resume = g_devState.resume;
+static WakeTimingRing &g_wakeTiming = g_devState.timing;
+static FrameTable &g_frames = g_devState.frames;
+static PlaylistTable &g_playlist = g_devState.playlist;
+static PlaylistCursor &g_playlistCursor = g_devState.playlistCursor;
+
+static inline uint32_t deviceStateCrc()
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&g_devState, offsetof(DeviceState, crc));
+}
+
+/**
+ * 从 NVS 载入持久化字段（冷启动时调用一次），其余字段清零
+ */
+static void deviceStateLoadNvs()
+{
+    memset(&g_devState, 0, sizeof(g_devState));
+    g_devState.magic = DEVICE_STATE_MAGIC;
+    g_devState.size = sizeof(DeviceState);
+    g_devState.frames.current = FRAME_SLOT_NONE;
+    g_devState.frames.base = FRAME_SLOT_NONE;
+
+    // 命名空间不存在（第一次使用）时 begin 失败，对应字段保持默认值
+    if (preferences.begin(PREF_NAMESPACE, true)) {
+        g_devState.claimed = preferences.getBool(PREF_KEY_CLAIMED, false);
+        g_devState.imageVersion = preferences.getInt(PREF_KEY_IMG_VER, 0);
+        if (preferences.getBytesLength(PREF_KEY_FRAMES) == sizeof(g_devState.frames)) {
+            preferences.getBytes(PREF_KEY_FRAMES, &g_devState.frames, sizeof(g_devState.frames));
+        }
+        if (preferences.getBytesLength(PREF_KEY_PLAYLIST) == sizeof(g_devState.playlist)) {
+            preferences.getBytes(PREF_KEY_PLAYLIST, &g_devState.playlist, sizeof(g_devState.playlist));
+        }
+    }
+    preferences.end();
+
+    if (preferences.begin(CONFIG_NAMESPACE, true)) {
+        if (preferences.getBool(CONFIG_CONFIGURED_KEY, false)) {
+            String ssid = preferences.getString(CONFIG_SSID_KEY, "");
+            String password = preferences.getString(CONFIG_PASSWORD_KEY, "");
+            if (ssid.length() > 0 && ssid.length() < sizeof(g_devState.ssid) &&
+                password.length() < sizeof(g_devState.password)) {
+                strcpy(g_devState.ssid, ssid.c_str());
+                strcpy(g_devState.password, password.c_str());
+                g_devState.wifiConfigured = 1;
+            }
+        }
+        if (preferences.getBytesLength(CONFIG_FAST_KEY) == sizeof(g_devState.wifi)) {
+            preferences.getBytes(CONFIG_FAST_KEY, &g_devState.wifi, sizeof(g_devState.wifi));
+            // NVS 中的地址可能早已过了租期：冷启动只复用信道/BSSID，地址先走一次 DHCP
+            g_devState.wifi.reuse = WIFI_FAST_REUSE_EXPIRED;
+        }
+    }
+    preferences.end();
+}
+
+/**
+ * setup 开始时调用：RTC 中的状态无效（冷启动）时从 NVS 载入
+ * @return 是否为冷启动
+ */
+static bool deviceStateInit()
+{
+    if (g_devState.magic == DEVICE_STATE_MAGIC && g_devState.size == sizeof(DeviceState) &&
+        g_devState.crc == deviceStateCrc()) {
+        return false;
+    }
+    deviceStateLoadNvs();
+    Serial.printf("📋 冷启动：已从 NVS 载入设备状态（claimed=%d, imgVer=%d, WiFi%s）\n",
+                  g_devState.claimed, (int)g_devState.imageVersion,
+                  g_devState.wifiConfigured ? "已配置" : "未配置");
+    return true;
+}
+
+/**
+ * 进入深睡前调用：重新计算 CRC，下次唤醒直接使用 RTC 中的状态
+ */
+static inline void deviceStateSeal()
+{
+    g_devState.crc = deviceStateCrc();
+}
+
+#endif // DEVICE_STATE_H
@@ -23,6 +23,8 @@
   *           
   ******************************************************************************
   */
+#include "DEV_Config.h"  // SPI后端（DEV_SPI_WriteByte）
+
 /* SPI pin definition --------------------------------------------------------*/
 //#include "epd7in5_HD.h"
 // 更改引脚以避免与外部Flash冲突（外部Flash使用GPIO14/15/16/17）
@@ -89,22 +91,9 @@ byte lut_partial_mono[] =
 /* The procedure of sending a byte to e-Paper by SPI -------------------------*/
 void EpdSpiTransferCallback(byte data) 
 {
-    //SPI.beginTransaction(spi_settings);
-    digitalWrite(PIN_SPI_CS, GPIO_PIN_RESET);
-
-    for (int i = 0; i < 8; i++)
-    {
-        if ((data & 0x80) == 0) digitalWrite(PIN_SPI_DIN, GPIO_PIN_RESET); 
-        else                    digitalWrite(PIN_SPI_DIN, GPIO_PIN_SET);
-
-        data <<= 1;
-        digitalWrite(PIN_SPI_SCK, GPIO_PIN_SET);
-        digitalWrite(PIN_SPI_SCK, GPIO_PIN_RESET);
-    }
-    
-    //SPI.transfer(data);
-    digitalWrite(PIN_SPI_CS, GPIO_PIN_SET);
-    //SPI.endTransaction();
+    // 统一走 DEV_Config.cpp 的SPI后端（硬件DMA或软件模拟，由 DEV_SPI_USE_HW 决定）
+    // 硬件后端接管SCK/MOSI后，这里再直接digitalWrite这两个引脚将不起作用
+    DEV_SPI_WriteByte(data);
 }
 
 // DEV_SPI_ReadByte 现在由 DEV_Config.cpp 提供（官方Demo驱动）
@@ -128,20 +117,9 @@ void EPD_SendCommand(byte command)
 
 void EPD_SendCommand_13in3E6(byte command) 
 {
+    // 与 EPD_SendCommand 相同，经 SPI 后端发送（不再直接翻转 DIN/SCK，硬件后端接管了这两个引脚）
     digitalWrite(PIN_SPI_DC, LOW);
-    //SPI.beginTransaction(spi_settings);
-    for (int i = 0; i < 8; i++)
-    {
-        if ((command & 0x80) == 0) digitalWrite(PIN_SPI_DIN, GPIO_PIN_RESET); 
-        else                    digitalWrite(PIN_SPI_DIN, GPIO_PIN_SET);
-
-        command <<= 1;
-        digitalWrite(PIN_SPI_SCK, GPIO_PIN_SET);
-        digitalWrite(PIN_SPI_SCK, GPIO_PIN_RESET);
-    }
-    
-    //SPI.transfer(command);
-    //SPI.endTransaction();
+    EpdSpiTransferCallback(command);
 }
 
 /* Sending a byte as a data --------------------------------------------------*/
@@ -153,34 +131,23 @@ void EPD_SendData(byte data)
 
 void EPD_SendData_13in3E6(byte data) 
 {
+    // 同 EPD_SendCommand_13in3E6
     digitalWrite(PIN_SPI_DC, HIGH);
-    //SPI.beginTransaction(spi_settings);
-    for (int i = 0; i < 8; i++)
-    {
-        if ((data & 0x80) == 0) digitalWrite(PIN_SPI_DIN, GPIO_PIN_RESET); 
-        else                    digitalWrite(PIN_SPI_DIN, GPIO_PIN_SET);
-
-        data <<= 1;
-        digitalWrite(PIN_SPI_SCK, GPIO_PIN_SET);
-        digitalWrite(PIN_SPI_SCK, GPIO_PIN_RESET);
-    }
-    
-    //SPI.transfer(data);
-    //SPI.endTransaction();
+    EpdSpiTransferCallback(data);
 }
 
 /* Waiting the e-Paper is ready for further instructions ---------------------*/
 void EPD_WaitUntilIdle() 
 {
     //0: busy, 1: idle
-    while(digitalRead(PIN_SPI_BUSY) == 0) delay(100);    
+    DEV_Wait_Busy(1, DEV_BUSY_TIMEOUT_MS);
 }
 
 /* Waiting the e-Paper is ready for further instructions ---------------------*/
 void EPD_WaitUntilIdle_high() 
 {
     //1: busy, 0: idle
-    while(digitalRead(PIN_SPI_BUSY) == 1) delay(100);    
+    DEV_Wait_Busy(0, DEV_BUSY_TIMEOUT_MS);
 }
 
 /* Send a one-argument command -----------------------------------------------*/
@@ -8,13 +8,10 @@
 // 引入官方Demo驱动
 #include "EPD_7in3e.h"
 #include "DEV_Config.h"  // 用于底层SPI函数
-#include <SPIFFS.h>
-#include <FS.h>
-
-// 如果FLASH_TEMP_FILE未定义，则定义它（避免包含顺序问题）
-#ifndef FLASH_TEMP_FILE
-#define FLASH_TEMP_FILE "/temp_image.bin"
-#endif
+#include "esp_timer.h"
+#include "epd_frame.h"
+#include "epd_decode.h"
+#include "wake_timing.h"
 
 // 这里不直接包含 buff.h，避免在同一个编译单元里重复定义全局变量
 // 只做前向声明，真正的定义仍在 buff.h 中，由其它文件（如 mqtt_config.h）包含
@@ -31,7 +28,9 @@ extern UBYTE globalImageBuffer[];
 int EPD_7in3E_init() 
 {
     Serial.print("\r\nEPD7in3E6 (使用官方Demo驱动)");
+    uint8_t prevPhase = wakeTimingSwitch(WAKE_PHASE_PANEL_INIT);
     EPD_7IN3E_Init();  // 调用官方Demo的初始化函数
+    wakeTimingSwitch(prevPhase);
     return 0;
 }
 
@@ -47,11 +46,130 @@ void EPD_7in3E_Clear(byte color)
     EPD_7IN3E_Clear((UBYTE)color);  // 调用官方Demo的清屏函数
 }
 
+// 行流水线统计（最近一次加载），用于判断瓶颈在Flash读取/解码还是SPI发送
+struct EPD_PipelineStats {
+    uint32_t produceUs;     // 读取+解码累计耗时
+    uint32_t spiStallUs;    // 下一行已就绪、等待上一行SPI发送完成的时间（SPI是瓶颈）
+    uint32_t flashStallUs;  // SPI已空闲、等待下一行数据就绪的时间（Flash/解码是瓶颈）
+};
+EPD_PipelineStats EPD_lastPipelineStats = { 0, 0, 0 };
+
+// 为true时加载完成后只发出刷新命令就返回，BUSY等待与断电交给调用方（刷新期间MCU可深睡）
+bool EPD_7in3E_deferRefreshWait = false;
+// 最近一次加载是否以“刷新已发出、尚未完成”结束
+bool EPD_7in3E_refreshInFlight = false;
+// 最近一次加载的是否为整帧 CRC 校验通过的 EPDF 帧（可以作为差分更新的基准帧保留）
+bool EPD_7in3E_frameVerified = false;
+// 最近一次加载是否发出了刷新（数据完整、校验通过，且屏幕没有等待BUSY超时）
+bool EPD_7in3E_frameShown = false;
+
+// 要加载的帧：调用方把帧分区的槽映射到地址空间后设置（见 frame_store.h），解码直接读映射的 Flash
+const uint8_t *EPD_7in3E_frameData = nullptr;
+int EPD_7in3E_frameSize = 0;
+
+// 映射内存上的顺序读取：直接返回指向映射区的指针，不拷贝
+struct EPD_MemReader {
+    const uint8_t *data;
+    int pos;
+    int end;            // 超出期望大小的部分不读
+};
+
+// 取至多 want 字节的连续数据（*data 指向映射区内部），返回字节数，0 表示没有更多数据
+static int EPD_7in3E_memNext(EPD_MemReader &m, const uint8_t **data, int want)
+{
+    int n = m.end - m.pos;
+    if (n > want) {
+        n = want;
+    }
+    *data = m.data + m.pos;
+    if (n <= 0) {
+        return 0;
+    }
+    m.pos += n;
+    return n;
+}
+
+// 帧的逐行读取状态（a~p 文本帧或 EPDF 二进制帧）
+struct EPD_FrameReader {
+    EPD_MemReader mem;
+    int format;        // EPD_FORMAT_TEXT / EPD_FORMAT_BIN / EPD_FORMAT_RLE
+    uint32_t crc;      // 二进制帧：已读 payload 的 CRC32
+    int bytesRead;     // 成功解码的字节数
+    int missingCount;  // 因数据不足填充白色的字节数
+    int invalidCount;  // 因无效字符填充白色的字节数
+};
+
+// 从二进制帧读取一行（payload 就是显存格式，从映射区拷贝到DMA行缓冲区）
+static void EPD_7in3E_readBinRow(EPD_FrameReader &r, UBYTE *row, int packedWidth)
+{
+    const uint8_t *p;
+    int col = EPD_7in3E_memNext(r.mem, &p, packedWidth);
+    memcpy(row, p, col);
+    r.crc = esp_rom_crc32_le(r.crc, p, col);
+    r.bytesRead += col;
+    if (col < packedWidth) {
+        // 数据不足，用白色填充
+        memset(row + col, 0x11, packedWidth - col);
+        r.missingCount += packedWidth - col;
+    }
+}
+
+// 从 RLE 帧读取一行：在映射区上直接展开到行缓冲区，不需要整帧缓冲
+static void EPD_7in3E_readRleRow(EPD_FrameReader &r, UBYTE *row, int packedWidth)
+{
+    const uint8_t *lenBuf;
+    if (EPD_7in3E_memNext(r.mem, &lenBuf, 2) < 2) {
+        // 数据不足，用白色填充
+        memset(row, 0x11, packedWidth);
+        r.missingCount += packedWidth;
+        return;
+    }
+    r.crc = esp_rom_crc32_le(r.crc, lenBuf, 2);
+    
+    int len = lenBuf[0] | (lenBuf[1] << 8);
+    bool ok = false;
+    if (len > 0 && len <= EPD_RLE_MAX_ROW(packedWidth)) {
+        const uint8_t *p;
+        int n = EPD_7in3E_memNext(r.mem, &p, len);
+        r.crc = esp_rom_crc32_le(r.crc, p, n);
+        ok = (n == len) && EPD_rleDecodeRow(p, len, row, packedWidth);
+    }
+    
+    if (ok) {
+        r.bytesRead += packedWidth;
+    } else {
+        // 行数据损坏，整行填充白色（CRC 也不会通过，最终会跳过刷新）
+        memset(row, 0x11, packedWidth);
+        r.invalidCount += packedWidth;
+    }
+}
+
+// 从文本帧读取一行（packedWidth字节，需要2*packedWidth个字符），直接解码映射区中的字符
+static void EPD_7in3E_readTextRow(EPD_FrameReader &r, UBYTE *row, int packedWidth)
+{
+    // 文本帧从槽的起点（64KB 对齐）开始、每行偶数个字符，行首总是字对齐（走 SWAR 路径）；
+    // 只有数据末尾才会剩单个字符
+    const uint8_t *p;
+    int n = EPD_7in3E_memNext(r.mem, &p, packedWidth * 2);
+    int col = n / 2;
+    int invalid = EPD_decodeChars((const char *)p, row, col);
+    r.invalidCount += invalid;
+    r.bytesRead += col - invalid;
+    
+    if (col < packedWidth) {
+        // 数据不足（含只剩一个字符的情况），用白色填充
+        memset(row + col, 0x11, packedWidth - col);
+        r.missingCount += packedWidth - col;
+    }
+}
+
 // 适配函数：从Flash加载数据到7.3E6（使用流式处理，避免大内存分配）
-// 这个函数会被EPD_dispLoad调用，用于MQTT模式的数据加载
+// 这个函数会被EPD_dispLoad调用，数据来自调用方映射好的帧槽（EPD_7in3E_frameData/frameSize）
 void EPD_load_7in3E_from_buff()
 {
-    // FLASH_TEMP_FILE已在mqtt_config.h中定义为宏
+    EPD_7in3E_refreshInFlight = false;
+    EPD_7in3E_frameVerified = false;
+    EPD_7in3E_frameShown = false;
     
     // 计算需要的缓冲区大小（4bit格式）
     int packedWidth = (EPD_7IN3E_WIDTH + 1) / 2;  // 400字节/行
@@ -61,116 +179,106 @@ void EPD_load_7in3E_from_buff()
     Serial.printf("   当前剩余内存: %d 字节\n", ESP.getFreeHeap());
     Serial.printf("   使用流式处理（行缓冲区）\n");
     
-    // 打开Flash临时文件
-    File file = SPIFFS.open(FLASH_TEMP_FILE, "r");
-    if (!file) {
-        Serial.println("❌ 无法打开Flash临时文件");
-        Serial.println("   可能原因：DOWNLOAD命令未执行或文件未创建");
-        return;
-    }
-    
-    int fileSize = file.size();
-    Serial.printf("📁 Flash文件大小: %d 字符 (%.2f KB)\n", fileSize, fileSize / 1024.0);
-    
-    // 计算期望的文件大小：800x480 4bit格式 = 192000字节 = 384000字符
-    int expectedChars = (EPD_7IN3E_WIDTH / 2) * EPD_7IN3E_HEIGHT * 2;  // 400 * 480 * 2 = 384000
-    Serial.printf("   期望大小: %d 字符 (%.2f KB)\n", expectedChars, expectedChars / 1024.0);
+    const uint8_t *data = EPD_7in3E_frameData;
+    int fileSize = data ? EPD_7in3E_frameSize : 0;
+    Serial.printf("📁 帧数据大小: %d 字节 (%.2f KB)\n", fileSize, fileSize / 1024.0);
     
     if (fileSize == 0) {
-        Serial.println("❌ Flash文件为空！");
-        Serial.println("   可能原因：DOWNLOAD命令未正确执行或数据未写入");
-        file.close();
+        Serial.println("❌ 帧数据为空！");
+        Serial.println("   可能原因：帧槽未映射或数据未写入");
         return;
     }
     
-    if (fileSize < expectedChars) {
-        Serial.printf("⚠️  警告：文件大小不完整！期望 %d 字符，实际 %d 字符，缺少 %d 字符\n", 
-                      expectedChars, fileSize, expectedChars - fileSize);
+    // 根据文件头判断格式：EPDF 二进制帧，或 a~p 文本帧
+    EPD_FrameHeader header;
+    int format = EPD_FORMAT_TEXT;
+    int expectedSize = (EPD_7IN3E_WIDTH / 2) * EPD_7IN3E_HEIGHT * 2;  // 文本帧：400 * 480 * 2 = 384000 字符
+    {
+        int headLen = fileSize < EPD_FRAME_HEADER_SIZE ? fileSize : EPD_FRAME_HEADER_SIZE;
+        if (EPD_isFrame(data, headLen)) {
+            if (!EPD_parseFrameHeader(data, headLen, &header) ||
+                !EPD_frameMatchesPanel(&header, EPD_7IN3E_WIDTH, EPD_7IN3E_HEIGHT)) {
+                Serial.println("❌ 二进制帧头无效或与屏幕尺寸/像素格式不符，跳过刷新");
+                return;
+            }
+            format = (header.pixelFormat == EPD_PIXFMT_RLE4) ? EPD_FORMAT_RLE : EPD_FORMAT_BIN;
+            expectedSize = header.headerLen + header.payloadLen;
+        }
+    }
+    Serial.printf("   数据格式: %s，期望大小: %d 字节 (%.2f KB)\n",
+                  format == EPD_FORMAT_RLE ? "RLE帧" : (format == EPD_FORMAT_BIN ? "二进制帧" : "a~p文本"), expectedSize, expectedSize / 1024.0);
+    
+    if (fileSize < expectedSize) {
+        Serial.printf("⚠️  警告：数据不完整！期望 %d 字节，实际 %d 字节，缺少 %d 字节\n", 
+                      expectedSize, fileSize, expectedSize - fileSize);
         Serial.println("   可能原因：HTTP下载不完整或网络中断");
         Serial.println("   底部区域将显示为白色");
-    } else if (fileSize > expectedChars) {
-        Serial.printf("⚠️  警告：文件大小超出！期望 %d 字符，实际 %d 字符，多出 %d 字符\n", 
-                      expectedChars, fileSize, fileSize - expectedChars);
-        Serial.println("   将只读取前 384000 字符");
+    } else if (fileSize > expectedSize) {
+        Serial.printf("⚠️  警告：数据超出！期望 %d 字节，实际 %d 字节，多出 %d 字节\n", 
+                      expectedSize, fileSize, fileSize - expectedSize);
+        Serial.printf("   将只读取前 %d 字节\n", expectedSize);
     } else {
-        Serial.println("✅ 文件大小正确");
+        Serial.println("✅ 数据大小正确");
     }
     
-    // 使用行缓冲区（400字节），避免大内存分配
-    UBYTE *rowBuffer = (UBYTE *)malloc(packedWidth);
-    if (!rowBuffer) {
-        Serial.printf("❌ 行缓冲区分配失败！需要 %d 字节，但只有 %d 字节可用\n", 
+    // 使用两个行缓冲区（各400字节）做乒乓：一行在DMA发送时，CPU读取并解码下一行
+    // 分配在DMA可访问内存，硬件SPI可直接发送
+    UBYTE *rowBuffers[2];
+    rowBuffers[0] = (UBYTE *)DEV_SPI_DmaMalloc(packedWidth);
+    rowBuffers[1] = (UBYTE *)DEV_SPI_DmaMalloc(packedWidth);
+    if (!rowBuffers[0] || !rowBuffers[1]) {
+        Serial.printf("❌ 行缓冲区分配失败！需要 2 x %d 字节，但只有 %d 字节可用\n", 
                       packedWidth, ESP.getFreeHeap());
-        file.close();
+        if (rowBuffers[0]) DEV_SPI_DmaFree(rowBuffers[0]);
+        if (rowBuffers[1]) DEV_SPI_DmaFree(rowBuffers[1]);
         return;
     }
     
-    Serial.printf("✅ 行缓冲区分配成功: %d 字节\n", packedWidth);
+    Serial.printf("✅ 行缓冲区分配成功: 2 x %d 字节（直接读取映射的Flash）\n", packedWidth);
     
     // 优化：减少日志输出
     // Serial.println("   初始化EPD（如果未初始化）...");
+    uint8_t prevPhase = wakeTimingSwitch(WAKE_PHASE_PANEL_INIT);
     EPD_7IN3E_Init();
+    wakeTimingSwitch(prevPhase);
     
     // 发送显示命令（0x10）- 开始写入图像数据
     // 优化：减少日志输出
     // Serial.println("   开始发送图像数据到EPD...");
-    DEV_Digital_Write(EPD_DC_PIN, 0);  // 命令模式
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x10);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
+    EPD_7IN3E_BeginImageData();  // 之后全部是数据，整帧保持数据模式
     
-    // 逐行处理：从Flash读取、转换、直接发送到显示驱动
-    int charIdx = 0;
-    int totalBytesRead = 0;
-    
-    int missingDataCount = 0;  // 统计缺失数据的次数
-    int invalidCharCount = 0;  // 统计无效字符的次数
+    // 逐行流水线：读取+解码第N+1行的同时，第N行在SPI上发送
+    int dataStart = (format != EPD_FORMAT_TEXT) ? header.headerLen : 0;
+    int dataSize = (fileSize < expectedSize ? fileSize : expectedSize) - dataStart;
+    EPD_FrameReader reader = { { data, dataStart, dataStart + dataSize }, format, 0, 0, 0, 0 };
+    EPD_PipelineStats stats = { 0, 0, 0 };
+    bool spiBusy = false;
+    int cur = 0;
     
     for (int row = 0; row < EPD_7IN3E_HEIGHT; row++) {
-        // 读取一行数据（packedWidth字节，需要2*packedWidth个字符）
-        for (int col = 0; col < packedWidth; col++) {
-            // 读取两个字符组成一个字节
-            if (charIdx >= fileSize || !file.available()) {
-                // 数据不足，用白色填充
-                rowBuffer[col] = 0x11;  // 两个白色像素
-                missingDataCount++;
-                continue;
-            }
-            
-            char c1 = file.read();
-            charIdx++;
-            
-            if (charIdx >= fileSize || !file.available()) {
-                // 只有一个字符，用白色填充
-                rowBuffer[col] = 0x11;
-                missingDataCount++;
-                continue;
-            }
-            
-            char c2 = file.read();
-            charIdx++;
-            
-            // 优化：简化字符验证（只检查范围，不打印日志，提升速度）
-            if (c1 < 'a' || c1 > 'p' || c2 < 'a' || c2 > 'p') {
-                // 无效字符，用白色填充
-                rowBuffer[col] = 0x11;
-                invalidCharCount++;
-                // 优化：只在最后统计时报告，不逐行打印
-                continue;
-            }
-            
-            // 将两个字符转换为字节
-            int low = (c1 - 'a') & 0x0F;
-            int high = (c2 - 'a') & 0x0F;
-            
-            // 打包成字节：高4bit是high，低4bit是low
-            rowBuffer[col] = (UBYTE)((high << 4) | low);
-            totalBytesRead++;
+        int64_t t0 = esp_timer_get_time();
+        if (format == EPD_FORMAT_BIN) {
+            EPD_7in3E_readBinRow(reader, rowBuffers[cur], packedWidth);
+        } else if (format == EPD_FORMAT_RLE) {
+            EPD_7in3E_readRleRow(reader, rowBuffers[cur], packedWidth);
+        } else {
+            EPD_7in3E_readTextRow(reader, rowBuffers[cur], packedWidth);
         }
+        int64_t t1 = esp_timer_get_time();
+        stats.produceUs += (uint32_t)(t1 - t0);
         
-        // 优化：使用批量SPI传输函数，大幅提升速度（减少CS切换次数）
-        DEV_Digital_Write(EPD_DC_PIN, 1);  // 数据模式
-        DEV_SPI_Write_nByte(rowBuffer, packedWidth);  // 批量发送整行（400字节）
+        // 等上一行发完再启动本行（同一时间只有一个DMA事务）
+        if (spiBusy) {
+            int64_t doneUs = DEV_SPI_Write_nByte_Wait();
+            int64_t t2 = esp_timer_get_time();
+            stats.spiStallUs += (uint32_t)(t2 - t1);          // 数据已就绪，等SPI
+            if (t1 > doneUs) {
+                stats.flashStallUs += (uint32_t)(t1 - doneUs); // SPI已空闲，等数据
+            }
+        }
+        DEV_SPI_Write_nByte_Start(rowBuffers[cur], packedWidth);
+        spiBusy = true;
+        cur ^= 1;
         
         // 优化：减少进度日志输出频率（从每50行改为每100行）
         if ((row + 1) % 100 == 0) {
@@ -178,93 +286,316 @@ void EPD_load_7in3E_from_buff()
                           (row + 1) * 100.0 / EPD_7IN3E_HEIGHT);
         }
     }
+    if (spiBusy) {
+        DEV_SPI_Write_nByte_Wait();
+    }
     
-    file.close();
-    free(rowBuffer);
+    DEV_SPI_DmaFree(rowBuffers[0]);
+    DEV_SPI_DmaFree(rowBuffers[1]);
+    EPD_lastPipelineStats = stats;
     
-    Serial.printf("✅ 已读取并发送 %d 字节，准备刷新显示\n", totalBytesRead);
-    if (missingDataCount > 0) {
-        Serial.printf("⚠️  警告：有 %d 个字节因数据不足被填充为白色\n", missingDataCount);
+    Serial.printf("✅ 已读取并发送 %d 字节，准备刷新显示\n", reader.bytesRead);
+    if (reader.missingCount > 0) {
+        Serial.printf("⚠️  警告：有 %d 个字节因数据不足被填充为白色\n", reader.missingCount);
     }
-    if (invalidCharCount > 0) {
-        Serial.printf("⚠️  警告：有 %d 个字节因无效字符被填充为白色\n", invalidCharCount);
+    if (reader.invalidCount > 0) {
+        Serial.printf("⚠️  警告：有 %d 个字节因无效字符/RLE行损坏被填充为白色\n", reader.invalidCount);
     }
+    // 两个停顿时间哪个大，瓶颈就在哪一侧
+    Serial.printf("⏱️  流水线: 读取+解码 %u ms, 等待SPI %u ms, SPI等待数据 %u ms\n",
+                  stats.produceUs / 1000, stats.spiStallUs / 1000, stats.flashStallUs / 1000);
     
-    // 刷新显示：需要完整的TurnOnDisplay流程
-    // 参考EPD_7IN3E_TurnOnDisplay的实现
-    // 优化：减少日志输出
-    // Serial.println("   执行完整的显示刷新流程...");
-    
-    // 1. 发送命令0x04（上电）
-    DEV_Digital_Write(EPD_DC_PIN, 0);  // 命令模式
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x04);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
-    
-    // 等待BUSY（优化：减少日志输出）
-    // Serial.println("   等待BUSY（上电）...");
-    while (!DEV_Digital_Read(EPD_BUSY_PIN)) {
-        delay(1);
+    // 二进制帧带 CRC：数据已写入屏幕显存，但刷新前仍可放弃，屏幕保持原画面
+    if (format != EPD_FORMAT_TEXT && reader.crc != header.crc32) {
+        Serial.printf("❌ 二进制帧CRC校验失败（期望 %08lX，实际 %08lX），跳过刷新\n",
+                      (unsigned long)header.crc32, (unsigned long)reader.crc);
+        EPD_7IN3E_Sleep();
+        return;
     }
+    EPD_7in3E_frameVerified = (format != EPD_FORMAT_TEXT);
     
-    // 2. 发送命令0x06（设置显示模式）并发送数据
-    DEV_Digital_Write(EPD_DC_PIN, 0);
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x06);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
-    
-    // 发送数据：0x6F, 0x1F, 0x17, 0x49
-    DEV_Digital_Write(EPD_DC_PIN, 1);  // 数据模式
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x6F);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
-    
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x1F);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
-    
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x17);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
-    
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x49);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
+    prevPhase = wakeTimingSwitch(WAKE_PHASE_REFRESH);
+    if (EPD_7in3E_deferRefreshWait) {
+        // 只发出刷新命令：上电 -> 第二项设置 -> 显示刷新，断电由调用方在BUSY变高后完成
+        bool started = EPD_7IN3E_RefreshStart();
+        wakeTimingSwitch(prevPhase);
+        if (!started) {
+            Serial.println("❌ 屏幕上电等待BUSY超时，刷新命令未发出");
+            return;
+        }
+        EPD_7in3E_refreshInFlight = true;
+        EPD_7in3E_frameShown = true;
+        Serial.println("✅ 刷新命令已发出（等待刷新完成交由调用方）");
+        return;
+    }
+
+    // 刷新显示：上电 -> 第二项设置 -> 显示刷新 -> 断电（命令表定义在 EPD_7in3e.cpp）
+    bool shown = EPD_7IN3E_TurnOnDisplay();
+    wakeTimingSwitch(prevPhase);
+    if (!shown) {
+        Serial.println("❌ 刷新等待BUSY超时，画面未确认");
+        return;
+    }
+    EPD_7in3E_frameShown = true;
     
-    // 3. 发送命令0x12（显示刷新）并发送数据0x00
-    DEV_Digital_Write(EPD_DC_PIN, 0);  // 命令模式
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x12);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
+    Serial.println("✅ 显示完成");
+}
+
+
+/* ---------------------------------------------------------------------------
+ * 推送式加载：下载数据不落 Flash，边收边解码直接写入屏幕显存（命令 0x10 的数据阶段）
+ * 格式识别、行流水线与 EPD_load_7in3E_from_buff 相同，只是数据由调用方分段送入；
+ * 屏幕在 0x12 之前只改显存不改画面，所以校验失败时不刷新即可保持原画面
+ * ------------------------------------------------------------------------- */
+
+#define EPD_STREAM_FORMAT_UNKNOWN (-1)
+
+struct EPD_StreamLoader {
+    UBYTE *rows[2];        // 乒乓行缓冲区（DMA可访问）
+    int cur;
+    bool spiBusy;
+    int row;               // 已送出的行数
+    int col;               // 当前行已填充的字节数
+    int format;            // EPD_FORMAT_*，收到帧头前为 EPD_STREAM_FORMAT_UNKNOWN
+    EPD_FrameHeader header;
+    uint8_t head[EPD_FRAME_HEADER_SIZE];
+    int headLen;
+    uint32_t skip;         // 帧头扩展部分（headerLen > 20）还需跳过的字节
+    uint32_t payloadLeft;  // 帧 payload 剩余字节
+    uint32_t crc;          // 帧 payload 的 CRC32
+    char textLow;          // 文本帧：跨段的半个字符对
+    bool hasTextLow;
+    uint8_t rle[2 + EPD_RLE_MAX_ROW((EPD_7IN3E_WIDTH + 1) / 2)];  // RLE 帧：当前行（含长度前缀）
+    int rleLen;
+    int invalidCount;
+    bool failed;
+};
+
+/**
+ * 开始推送式加载：分配行缓冲区、初始化屏幕并进入数据阶段
+ * @return 内存不足时返回 false（屏幕未被改动）
+ */
+bool EPD_7in3E_streamBegin(EPD_StreamLoader *s)
+{
+    const int packedWidth = (EPD_7IN3E_WIDTH + 1) / 2;
+    memset(s, 0, sizeof(*s));
+    s->format = EPD_STREAM_FORMAT_UNKNOWN;
+    EPD_7in3E_refreshInFlight = false;
+    EPD_7in3E_frameVerified = false;
     
-    DEV_Digital_Write(EPD_DC_PIN, 1);  // 数据模式
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x00);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
+    s->rows[0] = (UBYTE *)DEV_SPI_DmaMalloc(packedWidth);
+    s->rows[1] = (UBYTE *)DEV_SPI_DmaMalloc(packedWidth);
+    if (!s->rows[0] || !s->rows[1]) {
+        Serial.printf("❌ 行缓冲区分配失败！需要 2 x %d 字节\n", packedWidth);
+        if (s->rows[0]) DEV_SPI_DmaFree(s->rows[0]);
+        if (s->rows[1]) DEV_SPI_DmaFree(s->rows[1]);
+        return false;
+    }
     
-    // 等待BUSY（显示刷新）（优化：减少日志输出）
-    // Serial.println("   等待BUSY（显示刷新）...");
-    while (!DEV_Digital_Read(EPD_BUSY_PIN)) {
-        delay(1);
+    uint8_t prevPhase = wakeTimingSwitch(WAKE_PHASE_PANEL_INIT);
+    EPD_7IN3E_Init();
+    wakeTimingSwitch(prevPhase);
+    EPD_7IN3E_BeginImageData();
+    return true;
+}
+
+// 当前行已满：等上一行发完，启动本行DMA，切换到另一个行缓冲区
+static void EPD_7in3E_streamRowDone(EPD_StreamLoader *s)
+{
+    const int packedWidth = (EPD_7IN3E_WIDTH + 1) / 2;
+    if (s->spiBusy) {
+        DEV_SPI_Write_nByte_Wait();
+    }
+    DEV_SPI_Write_nByte_Start(s->rows[s->cur], packedWidth);
+    s->spiBusy = true;
+    s->cur ^= 1;
+    s->row++;
+    s->col = 0;
+}
+
+// 识别格式：文本帧首字节在 a~p 范围内，EPDF 帧以 'E' 开头，收齐 20 字节帧头后校验
+static size_t EPD_7in3E_streamHeader(EPD_StreamLoader *s, const uint8_t *data, size_t len)
+{
+    if (s->headLen == 0 && data[0] != EPD_FRAME_MAGIC[0]) {
+        s->format = EPD_FORMAT_TEXT;
+        return 0;
+    }
+    size_t n = EPD_FRAME_HEADER_SIZE - s->headLen;
+    if (n > len) {
+        n = len;
+    }
+    memcpy(s->head + s->headLen, data, n);
+    s->headLen += n;
+    if (s->headLen < EPD_FRAME_HEADER_SIZE) {
+        return n;
     }
+    if (!EPD_parseFrameHeader(s->head, s->headLen, &s->header) ||
+        !EPD_frameMatchesPanel(&s->header, EPD_7IN3E_WIDTH, EPD_7IN3E_HEIGHT)) {
+        Serial.println("❌ 二进制帧头无效或与屏幕尺寸/像素格式不符");
+        s->failed = true;
+        return n;
+    }
+    s->format = (s->header.pixelFormat == EPD_PIXFMT_RLE4) ? EPD_FORMAT_RLE : EPD_FORMAT_BIN;
+    s->skip = s->header.headerLen - EPD_FRAME_HEADER_SIZE;
+    s->payloadLeft = s->header.payloadLen;
+    return n;
+}
+
+/**
+ * 送入一段下载数据（已解压），满一行就发送到屏幕
+ * @return 数据格式错误或超出一帧时返回 false，之后的数据都会被拒绝
+ */
+bool EPD_7in3E_streamFeed(EPD_StreamLoader *s, const uint8_t *data, size_t len)
+{
+    const int packedWidth = (EPD_7IN3E_WIDTH + 1) / 2;
+    size_t pos = 0;
     
-    // 4. 发送命令0x02（断电）
-    DEV_Digital_Write(EPD_DC_PIN, 0);  // 命令模式
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x02);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
+    if (s->failed) {
+        return false;
+    }
+    if (s->format == EPD_STREAM_FORMAT_UNKNOWN && len > 0) {
+        pos += EPD_7in3E_streamHeader(s, data, len);
+    }
+    if (s->skip > 0 && pos < len) {
+        size_t n = (len - pos < s->skip) ? len - pos : s->skip;
+        pos += n;
+        s->skip -= n;
+    }
+    if (s->format != EPD_FORMAT_TEXT && pos < len) {
+        // 帧 payload：CRC 覆盖全部 payload 字节（RLE 包括行长度前缀）
+        if (len - pos > s->payloadLeft) {
+            Serial.println("❌ 数据超出帧 payload 长度");
+            s->failed = true;
+            return false;
+        }
+        s->crc = esp_rom_crc32_le(s->crc, data + pos, len - pos);
+        s->payloadLeft -= len - pos;
+    }
     
-    DEV_Digital_Write(EPD_DC_PIN, 1);  // 数据模式
-    DEV_Digital_Write(EPD_CS_PIN, 0);
-    DEV_SPI_WriteByte(0x00);
-    DEV_Digital_Write(EPD_CS_PIN, 1);
+    while (!s->failed && pos < len) {
+        if (s->row >= EPD_7IN3E_HEIGHT) {
+            Serial.println("❌ 数据超出一帧");
+            s->failed = true;
+            break;
+        }
+        UBYTE *dst = s->rows[s->cur] + s->col;
+        
+        if (s->format == EPD_FORMAT_BIN) {
+            size_t n = packedWidth - s->col;
+            if (n > len - pos) {
+                n = len - pos;
+            }
+            memcpy(dst, data + pos, n);
+            pos += n;
+            s->col += n;
+        } else if (s->format == EPD_FORMAT_RLE) {
+            // 收齐一行（u16 长度 + token）再展开
+            if (s->rleLen < 2) {
+                s->rle[s->rleLen++] = data[pos++];
+                continue;
+            }
+            int need = 2 + EPD_frameRd16(s->rle);
+            if (need > (int)sizeof(s->rle)) {
+                Serial.println("❌ RLE 行长度超出上限");
+                s->failed = true;
+                break;
+            }
+            size_t n = need - s->rleLen;
+            if (n > len - pos) {
+                n = len - pos;
+            }
+            memcpy(s->rle + s->rleLen, data + pos, n);
+            s->rleLen += n;
+            pos += n;
+            if (s->rleLen < need) {
+                continue;
+            }
+            if (!EPD_rleDecodeRow(s->rle + 2, need - 2, s->rows[s->cur], packedWidth)) {
+                Serial.printf("❌ RLE 第 %d 行数据损坏\n", s->row);
+                s->failed = true;
+                break;
+            }
+            s->rleLen = 0;
+            s->col = packedWidth;
+        } else {
+            // a~p 文本：先补齐上一段留下的半个字符对，其余整段用 SWAR 解码
+            if (s->hasTextLow) {
+                int b = EPD_decodeCharPair(s->textLow, (char)data[pos++]);
+                *dst = (b < 0) ? EPD_DECODE_FILL : (UBYTE)b;
+                s->invalidCount += (b < 0);
+                s->hasTextLow = false;
+                s->col++;
+            } else {
+                size_t n = (len - pos) / 2;
+                if (n > (size_t)(packedWidth - s->col)) {
+                    n = packedWidth - s->col;
+                }
+                if (n == 0) {
+                    s->textLow = (char)data[pos++];
+                    s->hasTextLow = true;
+                    continue;
+                }
+                s->invalidCount += EPD_decodeChars((const char *)data + pos, dst, n);
+                pos += 2 * n;
+                s->col += n;
+            }
+        }
+        
+        if (s->col == packedWidth) {
+            EPD_7in3E_streamRowDone(s);
+        }
+    }
+    return !s->failed;
+}
+
+/**
+ * 结束推送式加载
+ * @param commit 调用方的校验（长度、哈希）是否通过
+ * @return 已发出刷新返回 true；数据不完整、CRC 不符或 commit 为 false 时不刷新，屏幕断电进入睡眠
+ */
+bool EPD_7in3E_streamEnd(EPD_StreamLoader *s, bool commit)
+{
+    if (s->spiBusy) {
+        DEV_SPI_Write_nByte_Wait();
+    }
+    DEV_SPI_DmaFree(s->rows[0]);
+    DEV_SPI_DmaFree(s->rows[1]);
     
-    // 等待BUSY（断电）（优化：减少日志输出）
-    // Serial.println("   等待BUSY（断电）...");
-    while (!DEV_Digital_Read(EPD_BUSY_PIN)) {
-        delay(1);
+    bool complete = !s->failed && s->row == EPD_7IN3E_HEIGHT;
+    if (complete && s->format != EPD_FORMAT_TEXT) {
+        complete = (s->payloadLeft == 0 && s->crc == s->header.crc32);
+    } else if (complete) {
+        complete = !s->hasTextLow;
+    }
+    if (s->invalidCount > 0) {
+        Serial.printf("⚠️  警告：有 %d 个字节因无效字符被填充为白色\n", s->invalidCount);
     }
+    if (!complete || !commit) {
+        Serial.printf("❌ 直写屏幕数据未通过校验（%d/%d 行%s），不刷新，保持原画面\n",
+                      s->row, EPD_7IN3E_HEIGHT, complete ? "，哈希/长度不符" : "");
+        EPD_7IN3E_Sleep();
+        return false;
+    }
+    EPD_7in3E_frameVerified = (s->format != EPD_FORMAT_TEXT);
     
+    uint8_t prevPhase = wakeTimingSwitch(WAKE_PHASE_REFRESH);
+    if (EPD_7in3E_deferRefreshWait) {
+        bool started = EPD_7IN3E_RefreshStart();
+        wakeTimingSwitch(prevPhase);
+        if (!started) {
+            Serial.println("❌ 屏幕上电等待BUSY超时，刷新命令未发出");
+            return false;
+        }
+        EPD_7in3E_refreshInFlight = true;
+        Serial.println("✅ 刷新命令已发出（等待刷新完成交由调用方）");
+        return true;
+    }
+    bool shown = EPD_7IN3E_TurnOnDisplay();
+    wakeTimingSwitch(prevPhase);
+    if (!shown) {
+        Serial.println("❌ 刷新等待BUSY超时，画面未确认");
+        return false;
+    }
     Serial.println("✅ 显示完成");
+    return true;
 }
-
@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file    epd_decode.h
+  * @brief   a~p 文本编码解码（每两个字符一个字节：第1个字符为低4bit，第2个为高4bit）
+  *          EPD_decodeChars 用 32bit SWAR 每次处理 8 个字符：
+  *          一次掩码运算校验 8 个字符，无效字符对的计数也不按字符分支
+  *          不依赖 Arduino，可在主机上编译（见 tools/bench_decode.cpp）
+  ******************************************************************************
+  */
+
+#ifndef EPD_DECODE_H
+#define EPD_DECODE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// 无效字符对的替代值：两个白色像素
+#define EPD_DECODE_FILL 0x11
+
+/**
+ * 解码一个字符对
+ * @return 字节值；任一字符不在 a~p 范围内返回 -1
+ */
+static inline int EPD_decodeCharPair(char lo, char hi)
+{
+    if (lo < 'a' || lo > 'p' || hi < 'a' || hi > 'p') return -1;
+    return (lo - 'a') | ((hi - 'a') << 4);
+}
+
+/**
+ * 4 个字符（小端读入的一个字）的有效性：无效字符所在字节的 bit7 置位，全部有效时为 0
+ */
+static inline uint32_t EPD_swarInvalid(uint32_t w)
+{
+    const uint32_t H = 0x80808080u;
+    uint32_t w7 = w & 0x7F7F7F7Fu;
+    // 每字节最高位：>= 'a'（0x61）则 +0x1F 后置位，> 'p'（0x70）则 +0x0F 后置位；w7 每字节 <= 0x7F，不会跨字节进位
+    uint32_t geA = (w7 + 0x1F1F1F1Fu) & H;
+    uint32_t gtP = (w7 + 0x0F0F0F0Fu) & H;
+    return (w & H) | (geA ^ H) | gtP;
+}
+
+/**
+ * 4 个有效字符 -> 2 个字节（返回值低 16 位，小端：字节0 = c0 | c1<<4，字节1 = c2 | c3<<4）
+ */
+static inline uint32_t EPD_swarPack(uint32_t w)
+{
+    uint32_t v = (w - 0x61616161u) & 0x0F0F0F0Fu;
+    uint32_t p = (v | (v >> 4)) & 0x00FF00FFu;
+    return (p | (p >> 8)) & 0xFFFFu;
+}
+
+/**
+ * 同 EPD_swarPack，但允许含无效字符：无效字符对写为 EPD_DECODE_FILL
+ * @param invalidPairs 输出：本字中无效字符对的个数（0~2）
+ */
+static inline uint32_t EPD_swarPackChecked(uint32_t w, int *invalidPairs)
+{
+    uint32_t inv = EPD_swarInvalid(w);
+    // 先把每字节最高位置1再减 'a'，保证无效字节不会向相邻字节借位
+    uint32_t v = ((w | 0x80808080u) - 0x61616161u) & 0x0F0F0F0Fu;
+    uint32_t p = (v | (v >> 4)) & 0x00FF00FFu;
+
+    // 字符对中任一字符无效即整对无效：标志位落在 bit7 / bit23
+    uint32_t pinv = (inv | (inv >> 8)) & 0x00800080u;
+    *invalidPairs = (int)(((pinv >> 7) & 1) + ((pinv >> 23) & 1));
+    uint32_t sel = (pinv >> 7) * 0xFFu;  // 无效对所在字节为 0xFF
+    p = (p & ~sel) | (((uint32_t)EPD_DECODE_FILL * 0x00010001u) & sel);
+    return (p | (p >> 8)) & 0xFFFFu;
+}
+
+/**
+ * 解码 nBytes 个字节（需要 2*nBytes 个字符），无效字符对写为 EPD_DECODE_FILL
+ * src 4 字节对齐时走 SWAR 路径：每次读 8 个字符、一次掩码判断、写 4 个字节；
+ * 只有含无效字符的 8 字符组才走带填充的路径。否则逐对解码
+ * （按小端字节序组合，ESP32 与 x86 主机均适用）
+ * @return 无效字符对的个数
+ */
+static inline int EPD_decodeChars(const char *src, uint8_t *dst, int nBytes)
+{
+    int invalid = 0;
+    int i = 0;
+
+    if (((uintptr_t)src & 3) == 0) {
+        const uint8_t *s = (const uint8_t *)__builtin_assume_aligned(src, 4);
+        for (; i + 4 <= nBytes; i += 4) {
+            uint32_t w0, w1, out;
+            memcpy(&w0, s + 2 * i, 4);
+            memcpy(&w1, s + 2 * i + 4, 4);
+            if ((EPD_swarInvalid(w0) | EPD_swarInvalid(w1)) == 0) {
+                out = EPD_swarPack(w0) | (EPD_swarPack(w1) << 16);
+            } else {
+                int n0, n1;
+                out = EPD_swarPackChecked(w0, &n0) | (EPD_swarPackChecked(w1, &n1) << 16);
+                invalid += n0 + n1;
+            }
+            memcpy(dst + i, &out, 4);
+        }
+    }
+
+    for (; i < nBytes; i++) {
+        int b = EPD_decodeCharPair(src[2 * i], src[2 * i + 1]);
+        if (b < 0) {
+            dst[i] = EPD_DECODE_FILL;
+            invalid++;
+        } else {
+            dst[i] = (uint8_t)b;
+        }
+    }
+    return invalid;
+}
+
+#endif // EPD_DECODE_H
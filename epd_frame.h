@@ -0,0 +1,158 @@
+/**
+  ******************************************************************************
+  * @file    epd_frame.h
+  * @brief   EPDF 二进制帧格式（与云端 cloud_server/backend/epd_frame.py 一致）
+  *          a~p 文本编码每像素一个字符（384000 字符），二进制帧直接传输
+  *          4bit 打包像素（192000 字节），下载、写Flash、读Flash的数据量都减半
+  *
+  *          帧布局（小端）：
+  *            0  magic "EPDF"   4  version   5  pixelFormat
+  *            6  width          8  height    10 headerLen
+  *            12 payloadLen     16 crc32（payload 的 CRC32，esp_rom_crc32_le）
+  *
+  *          RLE（pixelFormat 2）按行编码，每行 = u16 编码长度 + token：
+  *            0x00~0x3F 字面量 t+1 字节；0x40~0x7F 下一字节重复 (t&0x3F)+3 次；
+  *            0x80~0xFF 纯色 1ccc nnnn，字节 ccc|ccc<<4 重复 nnnn+1 次
+  *            （nnnn==0xF 时再读 1 字节 k，重复 16+k 次）
+  *
+  *          差分（pixelFormat 3）相对设备上保存的基准帧（BIN4）只传变化的行：
+  *            u32 baseCrc  u32 targetCrc  u16 rangeCount，
+  *            然后每段 u16 rowStart  u16 rowCount  + rowCount 行 BIN4 数据
+  *            baseCrc / targetCrc 为基准帧 / 结果帧 payload 的 CRC32
+  ******************************************************************************
+  */
+
+#ifndef EPD_FRAME_H
+#define EPD_FRAME_H
+
+#include <stdint.h>
+#include <string.h>
+#include "esp_rom_crc.h"
+
+#define EPD_FRAME_MAGIC       "EPDF"
+#define EPD_FRAME_VERSION     1
+#define EPD_FRAME_HEADER_SIZE 20
+
+// 像素格式
+#define EPD_PIXFMT_BIN4       1   // 每字节两个像素，字节值与 a~p 字符对解码结果相同
+#define EPD_PIXFMT_RLE4       2   // EPD_PIXFMT_BIN4 按行 RLE 压缩，行之间互相独立
+#define EPD_PIXFMT_DELTA4     3   // 相对基准帧的变化行（不能直接显示，需先打补丁）
+
+// 差分帧 payload 的固定前缀和每段行范围的头部大小
+#define EPD_DELTA_PREFIX_SIZE 10
+#define EPD_DELTA_RANGE_SIZE  4
+
+// RLE 一行编码后的最大长度（全部是字面量时：每 64 字节多 1 个 token）
+#define EPD_RLE_MAX_ROW(rowBytes) ((rowBytes) + ((rowBytes) + 63) / 64)
+
+// 设备声明支持的下载格式（status 请求中的 formats）
+#define EPD_FORMAT_TEXT       0   // a~p 文本（旧格式，所有固件都支持）
+#define EPD_FORMAT_BIN        1   // EPDF 二进制帧
+#define EPD_FORMAT_RLE        2   // EPDF 按行 RLE 帧
+#define EPD_FORMAT_DELTA      3   // EPDF 差分帧
+
+struct EPD_FrameHeader {
+    uint8_t  version;
+    uint8_t  pixelFormat;
+    uint16_t width;
+    uint16_t height;
+    uint16_t headerLen;
+    uint32_t payloadLen;
+    uint32_t crc32;
+};
+
+static inline uint16_t EPD_frameRd16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t EPD_frameRd32(const uint8_t *p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+/**
+ * 判断数据是否以 EPDF 帧头开始（文本帧首字节在 a~p 范围内，不会误判）
+ */
+static inline bool EPD_isFrame(const uint8_t *buf, size_t len)
+{
+    return len >= 4 && memcmp(buf, EPD_FRAME_MAGIC, 4) == 0;
+}
+
+/**
+ * 解析 EPDF 帧头
+ * @return magic/版本/头部长度不合法时返回 false
+ */
+static inline bool EPD_parseFrameHeader(const uint8_t *buf, size_t len, EPD_FrameHeader *h)
+{
+    if (len < EPD_FRAME_HEADER_SIZE || !EPD_isFrame(buf, len)) {
+        return false;
+    }
+    h->version     = buf[4];
+    h->pixelFormat = buf[5];
+    h->width       = EPD_frameRd16(buf + 6);
+    h->height      = EPD_frameRd16(buf + 8);
+    h->headerLen   = EPD_frameRd16(buf + 10);
+    h->payloadLen  = EPD_frameRd32(buf + 12);
+    h->crc32       = EPD_frameRd32(buf + 16);
+    return h->version == EPD_FRAME_VERSION && h->headerLen >= EPD_FRAME_HEADER_SIZE;
+}
+
+/**
+ * 检查帧是否适用于指定尺寸的 4bit 屏
+ */
+static inline bool EPD_frameMatchesPanel(const EPD_FrameHeader *h, uint16_t width, uint16_t height)
+{
+    uint32_t rowBytes = (width + 1) / 2;
+    if (h->width != width || h->height != height) {
+        return false;
+    }
+    if (h->pixelFormat == EPD_PIXFMT_BIN4) {
+        return h->payloadLen == rowBytes * height;
+    }
+    if (h->pixelFormat == EPD_PIXFMT_RLE4) {
+        return h->payloadLen >= 2u * height &&
+               h->payloadLen <= (2u + EPD_RLE_MAX_ROW(rowBytes)) * height;
+    }
+    return false;
+}
+
+/**
+ * 检查差分帧是否适用于指定尺寸的屏
+ */
+static inline bool EPD_deltaMatchesPanel(const EPD_FrameHeader *h, uint16_t width, uint16_t height)
+{
+    return h->pixelFormat == EPD_PIXFMT_DELTA4 &&
+           h->width == width && h->height == height &&
+           h->payloadLen >= EPD_DELTA_PREFIX_SIZE;
+}
+
+/**
+ * 解码一行 RLE（不含行长度前缀），直接展开到行缓冲区
+ * @return 数据越界或解码后不是正好 rowBytes 字节时返回 false
+ */
+static inline bool EPD_rleDecodeRow(const uint8_t *src, int srcLen, uint8_t *row, int rowBytes)
+{
+    int i = 0;
+    int o = 0;
+    while (i < srcLen) {
+        uint8_t t = src[i++];
+        int n;
+        if (t < 0x40) {
+            n = t + 1;
+            if (i + n > srcLen || o + n > rowBytes) return false;
+            memcpy(row + o, src + i, n);
+            i += n;
+        } else if (t < 0x80) {
+            n = (t & 0x3F) + 3;
+            if (i >= srcLen || o + n > rowBytes) return false;
+            memset(row + o, src[i++], n);
+        } else {
+            uint8_t c = (t >> 4) & 0x07;
+            n = (t & 0x0F) + 1;
+            if (n == 16) {
+                if (i >= srcLen) return false;
+                n += src[i++];
+            }
+            if (o + n > rowBytes) return false;
+            memset(row + o, c | (c << 4), n);
+        }
+        o += n;
+    }
+    return o == rowBytes;
+}
+
+#endif // EPD_FRAME_H
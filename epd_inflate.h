@@ -0,0 +1,247 @@
+/**
+  ******************************************************************************
+  * @file    epd_inflate.h
+  * @brief   HTTP 下载的 Content-Encoding（deflate / gzip）流式解压
+  *          使用芯片 ROM 内置的 miniz tinfl，不增加固件体积；
+  *          解压窗口是 EPD_INFLATE_WINDOW 字节的环形缓冲区，每段解压结果直接交给回调写出
+  *
+  *          窗口小于 deflate 标准的 32KB，所以云端必须按设备在请求头
+  *          X-EPD-Inflate-Window（log2）中声明的窗口压缩：
+  *            deflate（zlib 格式）：zlib 头声明窗口大小，超过本地窗口时 tinfl 直接报错；
+  *                                  结尾 Adler32 由 tinfl 校验
+  *            gzip：头部在这里跳过，结尾 CRC32 / ISIZE 在 EPD_inflateFinish 中校验
+  *                  （取整个流的最后 8 字节：ROM 版 tinfl 结束时可能已多读了几个字节）
+  ******************************************************************************
+  */
+
+#ifndef EPD_INFLATE_H
+#define EPD_INFLATE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rom/miniz.h"
+#include "esp_rom_crc.h"
+
+// 解压窗口（log2），tinfl 要求环形缓冲区大小为 2 的幂
+#ifndef EPD_INFLATE_WINDOW_BITS
+#define EPD_INFLATE_WINDOW_BITS 12
+#endif
+#define EPD_INFLATE_WINDOW (1 << EPD_INFLATE_WINDOW_BITS)
+#if EPD_INFLATE_WINDOW_BITS < 9 || EPD_INFLATE_WINDOW_BITS > 15
+#error "EPD_INFLATE_WINDOW_BITS 必须在 9~15 之间（zlib 的窗口范围）"
+#endif
+
+// Content-Encoding
+#define EPD_ENCODING_IDENTITY 0
+#define EPD_ENCODING_DEFLATE  1   // HTTP 的 deflate 即 zlib 格式（RFC 1950）
+#define EPD_ENCODING_GZIP     2
+
+// gzip 头部/尾部解析状态（RFC 1952）
+enum {
+    EPD_GZ_FIXED,     // 固定 10 字节
+    EPD_GZ_XLEN,      // FEXTRA 长度（2 字节）
+    EPD_GZ_EXTRA,     // FEXTRA 内容
+    EPD_GZ_NAME,      // FNAME，以 0 结尾
+    EPD_GZ_COMMENT,   // FCOMMENT，以 0 结尾
+    EPD_GZ_HCRC,      // FHCRC（2 字节）
+    EPD_GZ_BODY,      // deflate 数据（之后是 8 字节 CRC32 + ISIZE）
+};
+
+#define EPD_GZ_FHCRC    0x02
+#define EPD_GZ_FEXTRA   0x04
+#define EPD_GZ_FNAME    0x08
+#define EPD_GZ_FCOMMENT 0x10
+
+// 解压输出回调：返回 false 中止解压（例如写 Flash 失败或数据超长）
+typedef bool (*EPD_InflateSink)(const uint8_t *data, size_t len, void *ctx);
+
+struct EPD_Inflater {
+    tinfl_decompressor *decomp;
+    uint8_t *window;
+    size_t windowPos;
+    int encoding;
+    int gzState;
+    uint8_t gzFlags;
+    uint8_t gzBuf[10];     // gzip 固定头
+    int gzLen;             // gzBuf 已收集的字节数
+    uint32_t gzSkip;       // FEXTRA 还需跳过的字节数
+    uint8_t tail[8];       // 输入流的最后 8 字节（gzip 尾部）
+    uint32_t inBytes;      // 输入的总字节数
+    uint32_t crc;          // gzip：解压数据的 CRC32
+    uint32_t outBytes;     // 解压后的总字节数
+    bool done;             // deflate 数据已结束
+};
+
+/**
+ * 初始化解压器（分配 tinfl 状态和窗口，约 11KB + EPD_INFLATE_WINDOW）
+ * @return 内存不足时返回 false
+ */
+static inline bool EPD_inflateBegin(EPD_Inflater *z, int encoding)
+{
+    memset(z, 0, sizeof(*z));
+    z->encoding = encoding;
+    z->gzState = EPD_GZ_FIXED;
+    z->decomp = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+    z->window = (uint8_t *)malloc(EPD_INFLATE_WINDOW);
+    if (!z->decomp || !z->window) {
+        free(z->decomp);
+        free(z->window);
+        z->decomp = NULL;
+        z->window = NULL;
+        return false;
+    }
+    tinfl_init(z->decomp);
+    return true;
+}
+
+static inline void EPD_inflateEnd(EPD_Inflater *z)
+{
+    free(z->decomp);
+    free(z->window);
+    z->decomp = NULL;
+    z->window = NULL;
+}
+
+/**
+ * 解析一个 gzip 头部字节
+ * @return 头部格式错误时返回 false
+ */
+static inline bool EPD_gzipHeaderByte(EPD_Inflater *z, uint8_t b)
+{
+    switch (z->gzState) {
+    case EPD_GZ_FIXED:
+        z->gzBuf[z->gzLen++] = b;
+        if (z->gzLen < 10) {
+            return true;
+        }
+        // ID1 ID2 CM(8 = deflate)
+        if (z->gzBuf[0] != 0x1F || z->gzBuf[1] != 0x8B || z->gzBuf[2] != 8) {
+            return false;
+        }
+        z->gzFlags = z->gzBuf[3];
+        z->gzLen = 0;
+        z->gzState = EPD_GZ_XLEN;
+        break;
+    case EPD_GZ_XLEN:
+        z->gzBuf[z->gzLen++] = b;
+        if (z->gzLen < 2) {
+            return true;
+        }
+        z->gzSkip = z->gzBuf[0] | (z->gzBuf[1] << 8);
+        z->gzLen = 0;
+        z->gzState = EPD_GZ_EXTRA;
+        break;
+    case EPD_GZ_EXTRA:
+        z->gzSkip--;
+        break;
+    case EPD_GZ_NAME:
+    case EPD_GZ_COMMENT:
+        if (b != 0) {
+            return true;
+        }
+        z->gzState++;
+        break;
+    case EPD_GZ_HCRC:
+        if (++z->gzLen < 2) {
+            return true;
+        }
+        z->gzLen = 0;
+        z->gzState = EPD_GZ_BODY;
+        return true;
+    }
+
+    // 跳过未设置标志位对应的可选字段
+    if (z->gzState == EPD_GZ_XLEN && !(z->gzFlags & EPD_GZ_FEXTRA)) z->gzState = EPD_GZ_NAME;
+    if (z->gzState == EPD_GZ_EXTRA && z->gzSkip == 0) z->gzState = EPD_GZ_NAME;
+    if (z->gzState == EPD_GZ_NAME && !(z->gzFlags & EPD_GZ_FNAME)) z->gzState = EPD_GZ_COMMENT;
+    if (z->gzState == EPD_GZ_COMMENT && !(z->gzFlags & EPD_GZ_FCOMMENT)) z->gzState = EPD_GZ_HCRC;
+    if (z->gzState == EPD_GZ_HCRC && !(z->gzFlags & EPD_GZ_FHCRC)) z->gzState = EPD_GZ_BODY;
+    return true;
+}
+
+/**
+ * 送入一段压缩数据，解压结果通过 sink 分段输出（每段不超过窗口剩余空间）
+ * deflate 数据结束（z->done）之后的输入只记录最后 8 字节
+ * @return 数据损坏、Adler32 校验失败或 sink 中止时返回 false
+ */
+static inline bool EPD_inflateFeed(EPD_Inflater *z, const uint8_t *in, size_t len, EPD_InflateSink sink, void *ctx)
+{
+    size_t pos = 0;
+    bool gzip = (z->encoding == EPD_ENCODING_GZIP);
+
+    if (len >= sizeof(z->tail)) {
+        memcpy(z->tail, in + len - sizeof(z->tail), sizeof(z->tail));
+    } else if (len > 0) {
+        memmove(z->tail, z->tail + len, sizeof(z->tail) - len);
+        memcpy(z->tail + sizeof(z->tail) - len, in, len);
+    }
+    z->inBytes += len;
+
+    while (gzip && z->gzState < EPD_GZ_BODY && pos < len) {
+        if (!EPD_gzipHeaderByte(z, in[pos++])) {
+            return false;
+        }
+    }
+
+    if (!z->done && (!gzip || z->gzState == EPD_GZ_BODY)) {
+        mz_uint32 flags = TINFL_FLAG_HAS_MORE_INPUT;
+        if (!gzip) {
+            flags |= TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32;
+        }
+        for (;;) {
+            size_t inSize = len - pos;
+            size_t outSize = EPD_INFLATE_WINDOW - z->windowPos;
+            tinfl_status st = tinfl_decompress(z->decomp, in + pos, &inSize,
+                                               z->window, z->window + z->windowPos, &outSize, flags);
+            pos += inSize;
+            if (outSize > 0) {
+                const uint8_t *out = z->window + z->windowPos;
+                if (gzip) {
+                    z->crc = esp_rom_crc32_le(z->crc, out, outSize);
+                }
+                z->outBytes += outSize;
+                z->windowPos = (z->windowPos + outSize) & (EPD_INFLATE_WINDOW - 1);
+                if (!sink(out, outSize, ctx)) {
+                    return false;
+                }
+            }
+            if (st < TINFL_STATUS_DONE) {
+                return false;
+            }
+            if (st == TINFL_STATUS_DONE) {
+                z->done = true;
+                break;
+            }
+            if (st == TINFL_STATUS_NEEDS_MORE_INPUT) {
+                break;
+            }
+            // TINFL_STATUS_HAS_MORE_OUTPUT：窗口写到末尾，回绕后继续
+        }
+    }
+
+    return true;
+}
+
+/**
+ * 输入全部送完后调用：检查数据是否完整
+ * @return deflate 数据未结束（下载被截断）或 gzip 尾部 CRC32/ISIZE 不符时返回 false
+ */
+static inline bool EPD_inflateFinish(const EPD_Inflater *z)
+{
+    if (!z->done) {
+        return false;
+    }
+    if (z->encoding != EPD_ENCODING_GZIP) {
+        return true;
+    }
+    if (z->inBytes < 10 + sizeof(z->tail)) {
+        return false;
+    }
+    const uint8_t *t = z->tail;
+    uint32_t crc = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+    uint32_t isize = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+    return crc == z->crc && isize == z->outBytes;
+}
+
+#endif // EPD_INFLATE_H
@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * @file    epd_playlist.h
+  * @brief   播放列表清单（与云端 cloud_server/backend/epd_playlist.py 一致）
+  *          GET /api/device/<id>/playlist，定长头部 + 若干变长条目，
+  *          读进栈上缓冲区后原地逐条解析，不用 JSON、不分配堆内存
+  *
+  *          布局（小端）：
+  *            0  magic "EPDL"   4  version   5  count   6  interval（分钟）
+  *            8  listId（同时用作 ETag "l<listId>"）
+  *            12 条目 x count：0 format   1 urlLen   4 size   8 sha256[32]   40 url（urlLen 字节，无结尾 0）
+  ******************************************************************************
+  */
+
+#ifndef EPD_PLAYLIST_H
+#define EPD_PLAYLIST_H
+
+#include <stdint.h>
+#include <string.h>
+#include "epd_frame.h"
+
+#define EPD_PLAYLIST_MAGIC    "EPDL"
+#define EPD_PLAYLIST_VERSION  1
+#define EPD_PLAYLIST_HEADER   12
+#define EPD_PLAYLIST_ENTRY    40
+#define EPD_PLAYLIST_MAX_URL  255
+#define EPD_PLAYLIST_MAX_RESP(pages) (EPD_PLAYLIST_HEADER + (pages) * (EPD_PLAYLIST_ENTRY + EPD_PLAYLIST_MAX_URL))
+
+struct EPD_Playlist {
+    uint8_t count;
+    uint16_t intervalMin;
+    uint32_t listId;
+};
+
+/**
+ * 一页的下载信息：url/sha256 直接指向清单缓冲区
+ */
+struct EPD_PlaylistEntry {
+    uint8_t format;          // EPD_FORMAT_*
+    uint8_t urlLen;
+    uint32_t size;
+    const uint8_t *sha256;   // 32 字节
+    const char *url;         // 不以 0 结尾，长度为 urlLen
+};
+
+/**
+ * 解析清单头部，并检查各条目恰好占满剩余长度
+ * @return magic/版本/长度不合法时返回 false
+ */
+static inline bool EPD_playlistParse(const uint8_t *buf, size_t len, EPD_Playlist *pl)
+{
+    if (len < EPD_PLAYLIST_HEADER || memcmp(buf, EPD_PLAYLIST_MAGIC, 4) != 0 || buf[4] != EPD_PLAYLIST_VERSION) {
+        return false;
+    }
+    pl->count = buf[5];
+    pl->intervalMin = EPD_frameRd16(buf + 6);
+    pl->listId = EPD_frameRd32(buf + 8);
+    size_t off = EPD_PLAYLIST_HEADER;
+    for (int i = 0; i < pl->count; i++) {
+        if (off + EPD_PLAYLIST_ENTRY > len || buf[off] > EPD_FORMAT_RLE) {
+            return false;
+        }
+        off += EPD_PLAYLIST_ENTRY + buf[off + 1];
+    }
+    return off == len && pl->listId != 0 && pl->intervalMin > 0;
+}
+
+/**
+ * 取第 index 个条目（清单须已通过 EPD_playlistParse）
+ */
+static inline void EPD_playlistEntry(const uint8_t *buf, int index, EPD_PlaylistEntry *e)
+{
+    size_t off = EPD_PLAYLIST_HEADER;
+    for (int i = 0; i < index; i++) {
+        off += EPD_PLAYLIST_ENTRY + buf[off + 1];
+    }
+    e->format = buf[off];
+    e->urlLen = buf[off + 1];
+    e->size = EPD_frameRd32(buf + off + 4);
+    e->sha256 = buf + off + 8;
+    e->url = (const char *)(buf + off + EPD_PLAYLIST_ENTRY);
+}
+
+#endif // EPD_PLAYLIST_H
@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * @file    epd_status.h
+  * @brief   二进制 status 协议（与云端 cloud_server/backend/epd_status.py 一致）
+  *          POST /api/device/status/bin，请求和响应都是定长头部 + 变长尾部，
+  *          在栈上缓冲区里直接打包/解析，不用 JSON、不分配堆内存
+  *
+  *          请求布局（小端）：
+  *            0  magic "EPDS"   4  version   5  formats（位 1<<EPD_FORMAT_*）
+  *            6  timingLen      8  baseVersion（0=无基准帧）   12 baseCrc
+  *            16 deviceId[12]（不足补 0）   28 timing（wake_timing.h 的紧凑文本）
+  *
+  *          响应布局（小端）：
+  *            0  magic "EPDS"   4  version   5  flags   6  format（EPD_FORMAT_*）
+  *            7  urlLen         8  imageVersion   12 imageSize（0=未知）
+  *            16 sha256[32]（flags 含 HAS_SHA 时有效）   48 url（urlLen 字节，无结尾 0）
+  ******************************************************************************
+  */
+
+#ifndef EPD_STATUS_H
+#define EPD_STATUS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "epd_frame.h"
+
+#define EPD_STATUS_MAGIC        "EPDS"
+#define EPD_STATUS_VERSION      1
+#define EPD_STATUS_REQ_HEADER   28
+#define EPD_STATUS_RESP_HEADER  48
+#define EPD_STATUS_DEVICE_ID    12
+#define EPD_STATUS_MAX_URL      255
+#define EPD_STATUS_MAX_TIMING   640
+#define EPD_STATUS_MAX_RESP     (EPD_STATUS_RESP_HEADER + EPD_STATUS_MAX_URL)
+
+// 响应 flags
+#define EPD_STATUS_F_CLAIMED    0x01   // 已绑定
+#define EPD_STATUS_F_HAS_IMAGE  0x02   // 有可下载的图片（url/format 有效）
+#define EPD_STATUS_F_HAS_SHA    0x04   // sha256 有效
+
+/**
+ * 解析后的响应：url/sha256 直接指向响应缓冲区
+ */
+struct EPD_StatusReply {
+    uint8_t flags;
+    uint8_t format;
+    uint32_t imageVersion;
+    uint32_t imageSize;
+    const uint8_t *sha256;   // 32 字节
+    const char *url;         // 不以 0 结尾，长度为 urlLen
+    uint8_t urlLen;
+};
+
+static inline void EPD_statusWr16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static inline void EPD_statusWr32(uint8_t *p, uint32_t v) { EPD_statusWr16(p, (uint16_t)v); EPD_statusWr16(p + 2, (uint16_t)(v >> 16)); }
+
+/**
+ * 打包请求
+ * @param formatMask 支持的格式（位 1<<EPD_FORMAT_*）
+ * @param timing 未上报的唤醒耗时（可为 NULL）
+ * @return 请求长度；缓冲区不够或参数超长时返回 -1
+ */
+static inline int EPD_statusPackRequest(uint8_t *buf, size_t cap, const char *deviceId, uint8_t formatMask,
+                                        uint32_t baseVersion, uint32_t baseCrc,
+                                        const char *timing, size_t timingLen)
+{
+    size_t idLen = strlen(deviceId);
+    if (!timing) {
+        timingLen = 0;
+    }
+    if (idLen > EPD_STATUS_DEVICE_ID || timingLen > EPD_STATUS_MAX_TIMING ||
+        cap < EPD_STATUS_REQ_HEADER + timingLen) {
+        return -1;
+    }
+    memcpy(buf, EPD_STATUS_MAGIC, 4);
+    buf[4] = EPD_STATUS_VERSION;
+    buf[5] = formatMask;
+    EPD_statusWr16(buf + 6, (uint16_t)timingLen);
+    EPD_statusWr32(buf + 8, baseVersion);
+    EPD_statusWr32(buf + 12, baseCrc);
+    memset(buf + 16, 0, EPD_STATUS_DEVICE_ID);
+    memcpy(buf + 16, deviceId, idLen);
+    if (timingLen > 0) {
+        memcpy(buf + EPD_STATUS_REQ_HEADER, timing, timingLen);
+    }
+    return (int)(EPD_STATUS_REQ_HEADER + timingLen);
+}
+
+/**
+ * 原地解析响应
+ * @return magic/版本/长度不合法时返回 false
+ */
+static inline bool EPD_statusParseReply(const uint8_t *buf, size_t len, EPD_StatusReply *r)
+{
+    if (len < EPD_STATUS_RESP_HEADER || memcmp(buf, EPD_STATUS_MAGIC, 4) != 0 || buf[4] != EPD_STATUS_VERSION) {
+        return false;
+    }
+    r->flags = buf[5];
+    r->format = buf[6];
+    r->urlLen = buf[7];
+    r->imageVersion = EPD_frameRd32(buf + 8);
+    r->imageSize = EPD_frameRd32(buf + 12);
+    r->sha256 = buf + 16;
+    r->url = (const char *)(buf + EPD_STATUS_RESP_HEADER);
+    return len == (size_t)EPD_STATUS_RESP_HEADER + r->urlLen && r->format <= EPD_FORMAT_DELTA;
+}
+
+#endif // EPD_STATUS_H
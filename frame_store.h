@@ -0,0 +1,281 @@
+/**
+  ******************************************************************************
+  * @file    frame_store.h
+  * @brief   帧存储：专用的原始 data 分区（partitions.csv 中的 frames），不经过文件系统
+  *          分区按 FRAME_SLOT_SIZE 分成若干槽，每个槽存一帧下载的数据（a~p 文本 / EPDF 帧）：
+  *          写入按 4KB 扇区擦除 + esp_partition_write，读取用 esp_partition_mmap 映射后直接解码
+  *
+  *          各槽的内容记在 g_frames（device_state.h，NVS 备份）。新数据总是写进空闲槽，
+  *          校验通过并显示后才设为当前槽，之前显示的帧和差分基准帧在此之前保持完整（A/B）。
+  *          当前槽一直保留到下一帧显示成功，屏幕画面被覆盖后可以不联网重显（按版本和 SHA-256 核对）；
+  *          播放列表（g_playlist）中各页所在的槽同样不会被选作写入槽，直到列表变化
+  ******************************************************************************
+  */
+
+#ifndef FRAME_STORE_H
+#define FRAME_STORE_H
+
+#include <Arduino.h>
+#include "esp_partition.h"
+#include "device_state.h"
+
+#define FRAME_PARTITION_LABEL "frames"
+#define FRAME_PARTITION_SUBTYPE 0x40   // 自定义 data 子类型（与 partitions.csv 一致）
+#define FRAME_SLOT_SIZE 0x60000        // 每槽 384KB：放得下 a~p 文本帧（384000 字节），64KB 对齐便于映射
+#define FRAME_SECTOR_SIZE 4096         // 擦除单位
+// 差分帧下载到槽的后半部分，打补丁的结果（bin 帧 192020 字节）写在同一槽的前半部分
+#define FRAME_DELTA_OFFSET 0x30000
+
+static const esp_partition_t *g_framePartition = nullptr;
+static int g_frameSlotCount = 0;
+
+/**
+ * 查找帧分区（只查分区表，不挂载文件系统；找到后直接返回）
+ * @return 分区不存在（未烧录新的分区表）时返回 false
+ */
+static bool frameStoreInit()
+{
+    if (g_framePartition) {
+        return true;
+    }
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           (esp_partition_subtype_t)FRAME_PARTITION_SUBTYPE,
+                                                           FRAME_PARTITION_LABEL);
+    int count = part ? (int)(part->size / FRAME_SLOT_SIZE) : 0;
+    if (count < 2) {
+        Serial.println("❌ 找不到帧分区 frames 或分区小于两个槽（请烧录新的 partitions.csv）");
+        return false;
+    }
+    g_framePartition = part;
+    g_frameSlotCount = count < FRAME_SLOT_MAX ? count : FRAME_SLOT_MAX;
+
+    // 分区变小（换了分区表）后，超出范围的槽引用作废
+    if (g_frames.current >= g_frameSlotCount) {
+        g_frames.current = FRAME_SLOT_NONE;
+    }
+    if (g_frames.base >= g_frameSlotCount) {
+        g_frames.base = FRAME_SLOT_NONE;
+    }
+    bool playlistValid = g_playlist.count <= PLAYLIST_MAX_PAGES;
+    for (int i = 0; playlistValid && i < g_playlist.count; i++) {
+        playlistValid = g_playlist.slot[i] < g_frameSlotCount;
+    }
+    if (!playlistValid) {
+        memset(&g_playlist, 0, sizeof(g_playlist));
+    }
+    Serial.printf("📁 帧分区: 0x%06lX，%d 个槽 x %d KB（当前帧: 槽 %d，基准帧: 槽 %d）\n",
+                  (unsigned long)part->address, g_frameSlotCount, FRAME_SLOT_SIZE / 1024,
+                  g_frames.current == FRAME_SLOT_NONE ? -1 : g_frames.current,
+                  g_frames.base == FRAME_SLOT_NONE ? -1 : g_frames.base);
+    return true;
+}
+
+/**
+ * 写入槽内 [offset, offset + len)：写到某个扇区的起始位置时先擦除该扇区
+ * 因此同一槽内的数据要从扇区起点开始按顺序写；从扇区中间接着写（断点续传）时
+ * 该扇区的剩余部分仍处于擦除状态，可以直接写
+ */
+static bool frameSlotWrite(int slot, uint32_t offset, const void *data, size_t len)
+{
+    if (offset + len > FRAME_SLOT_SIZE) {
+        return false;
+    }
+    uint32_t addr = (uint32_t)slot * FRAME_SLOT_SIZE + offset;
+    uint32_t end = addr + len;
+    uint32_t eraseStart = (addr + FRAME_SECTOR_SIZE - 1) & ~(uint32_t)(FRAME_SECTOR_SIZE - 1);
+    if (eraseStart < end) {
+        uint32_t eraseEnd = (end + FRAME_SECTOR_SIZE - 1) & ~(uint32_t)(FRAME_SECTOR_SIZE - 1);
+        if (esp_partition_erase_range(g_framePartition, eraseStart, eraseEnd - eraseStart) != ESP_OK) {
+            return false;
+        }
+    }
+    return esp_partition_write(g_framePartition, addr, data, len) == ESP_OK;
+}
+
+/**
+ * 读取槽内的一小段数据（帧头等）
+ */
+static bool frameSlotRead(int slot, uint32_t offset, void *buf, size_t len)
+{
+    return esp_partition_read(g_framePartition, (uint32_t)slot * FRAME_SLOT_SIZE + offset, buf, len) == ESP_OK;
+}
+
+/**
+ * 把槽内 [offset, offset + len) 映射到数据地址空间：解码直接读映射的 Flash（经 cache），不拷贝
+ * @return 映射失败时返回 NULL；用完调用 frameSlotUnmap
+ */
+static const uint8_t *frameSlotMap(int slot, uint32_t offset, size_t len, esp_partition_mmap_handle_t *handle)
+{
+    const void *ptr = nullptr;
+    if (len == 0 || offset + len > FRAME_SLOT_SIZE ||
+        esp_partition_mmap(g_framePartition, (uint32_t)slot * FRAME_SLOT_SIZE + offset, len,
+                           ESP_PARTITION_MMAP_DATA, &ptr, handle) != ESP_OK) {
+        return nullptr;
+    }
+    return (const uint8_t *)ptr;
+}
+
+static inline void frameSlotUnmap(esp_partition_mmap_handle_t handle)
+{
+    esp_partition_munmap(handle);
+}
+
+/**
+ * 槽是否在播放列表中
+ */
+static bool frameSlotInPlaylist(int slot)
+{
+    for (int i = 0; i < g_playlist.count; i++) {
+        if (g_playlist.slot[i] == slot) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * 槽的内容是否仍被引用（当前帧、基准帧或播放列表的页），被引用的槽不会被覆盖
+ */
+static inline bool frameSlotPinned(int slot)
+{
+    return slot == g_frames.current || slot == g_frames.base || frameSlotInPlaylist(slot);
+}
+
+/**
+ * 把槽表和播放列表写回 NVS（只在槽的内容变化时调用）
+ * 失败时 RTC 中记下 dirty：NVS 中的旧表可能仍引用 RTC 中已经空出的槽，写成功之前不再选槽写入
+ * @return 两项是否都已写入
+ */
+static bool frameTableSave()
+{
+    g_frames.dirty = 0;
+    bool ok = preferences.begin(PREF_NAMESPACE, false);
+    if (ok) {
+        ok = preferences.putBytes(PREF_KEY_FRAMES, &g_frames, sizeof(g_frames)) == sizeof(g_frames) &&
+             preferences.putBytes(PREF_KEY_PLAYLIST, &g_playlist, sizeof(g_playlist)) == sizeof(g_playlist);
+        preferences.end();
+    }
+    if (!ok) {
+        g_frames.dirty = 1;
+        Serial.println("⚠️  NVS写入失败，无法保存帧槽表");
+    }
+    return ok;
+}
+
+/**
+ * 不再被引用的槽标为空
+ */
+static void frameTableDropUnpinned()
+{
+    for (int i = 0; i < FRAME_SLOT_MAX; i++) {
+        if (!frameSlotPinned(i)) {
+            memset(&g_frames.slot[i], 0, sizeof(g_frames.slot[i]));
+        }
+    }
+}
+
+/**
+ * 选一个写入新数据的槽：不是当前显示的帧、差分基准帧或播放列表的页；优先空槽，其次版本最旧的槽
+ * 选中的槽在 RTC 中标为空（NVS 中的记录在下次提交时更新，它既不是当前帧也不是基准帧，不会被读取）
+ * 上次写回 NVS 失败时先重写；仍失败则不选槽（NVS 中的旧表可能还引用它）
+ * @param prefer 优先使用的槽（续传中的部分数据所在的槽），不可用时忽略
+ */
+static int frameSlotAcquire(int prefer)
+{
+    if (g_frames.dirty && !frameTableSave()) {
+        return -1;
+    }
+    int pick = -1;
+    for (int i = 0; i < g_frameSlotCount; i++) {
+        if (frameSlotPinned(i)) {
+            continue;
+        }
+        if (i == prefer) {
+            pick = i;
+            break;
+        }
+        if (pick < 0 || g_frames.slot[i].version < g_frames.slot[pick].version) {
+            pick = i;
+        }
+    }
+    if (pick >= 0) {
+        memset(&g_frames.slot[pick], 0, sizeof(g_frames.slot[pick]));
+    }
+    return pick;
+}
+
+/**
+ * 槽 slot 中的帧已显示：设为当前帧，asBase 时同时作为差分基准帧，写回 NVS
+ * 不再被引用的其他槽标为空
+ * @param meta 槽的内容（版本、大小、格式、CRC、SHA-256）
+ * @param settled 刷新已完成；刷新还在进行（MCU 深睡等待）时为 false，完成后调用 frameTableSetStale(false)
+ * @return 是否已写入 NVS；失败时 RTC 中的槽表照常更新，调用方不提交版本号
+ */
+static bool frameSlotCommit(int slot, const FrameSlot &meta, bool asBase, bool settled)
+{
+    g_frames.slot[slot] = meta;
+    g_frames.current = slot;
+    g_frames.stale = settled ? 0 : 1;
+    if (asBase) {
+        g_frames.base = slot;
+    }
+    frameTableDropUnpinned();
+    return frameTableSave();
+}
+
+/**
+ * 播放列表翻页：当前帧在列表的页之间切换时槽的内容不变，只改 RTC 中的当前帧，不写 NVS
+ * （冷启动后 NVS 中的当前帧仍是列表中的某一页，同样可以重显）；从单张图片切到列表时按 frameSlotCommit 处理
+ */
+static bool frameSlotFlipPage(int slot, const FrameSlot &meta, bool settled)
+{
+    if (g_frames.current == FRAME_SLOT_NONE || !frameSlotInPlaylist(g_frames.current)) {
+        return frameSlotCommit(slot, meta, false, settled);
+    }
+    g_frames.current = slot;
+    g_frames.stale = settled ? 0 : 1;
+    return true;
+}
+
+/**
+ * 屏幕上的画面是否为当前帧：显示设备码、刷新被打断时为 stale，重显或刷新完成后恢复
+ * 没有当前帧时不记录；当前帧是播放列表的页时只记在 RTC 中（见 frameSlotFlipPage）
+ * 上次写回 NVS 失败时即使 stale 没变也重写一次
+ * @return NVS 中的槽表是否与 RTC 一致
+ */
+static bool frameTableSetStale(bool stale)
+{
+    if (g_frames.current == FRAME_SLOT_NONE ||
+        (g_frames.stale == (stale ? 1 : 0) && !g_frames.dirty)) {
+        return !g_frames.dirty;
+    }
+    g_frames.stale = stale ? 1 : 0;
+    if (!frameSlotInPlaylist(g_frames.current)) {
+        return frameTableSave();
+    }
+    return !g_frames.dirty;
+}
+
+/**
+ * 屏幕内容不再来自帧分区（直写屏幕），或基准帧已不可用：取消对应的引用
+ * @return NVS 中的槽表是否与 RTC 一致（上次写回失败时在这里重写）
+ */
+static bool frameTableForget(bool current, bool base)
+{
+    bool changed = false;
+    if (current && g_frames.current != FRAME_SLOT_NONE) {
+        g_frames.current = FRAME_SLOT_NONE;
+        g_frames.stale = 0;
+        changed = true;
+    }
+    if (base && g_frames.base != FRAME_SLOT_NONE) {
+        g_frames.base = FRAME_SLOT_NONE;
+        changed = true;
+    }
+    if (changed || g_frames.dirty) {
+        return frameTableSave();
+    }
+    return true;
+}
+
+#endif // FRAME_STORE_H
@@ -17,8 +17,6 @@
 #include <ArduinoJson.h>
 #include <Preferences.h>
 #include <HTTPClient.h>
-#include <SPIFFS.h>
-#include <FS.h>
 #include "esp_wifi.h"
 #include "esp_sleep.h"
 #include "esp_err.h"
@@ -26,6 +24,16 @@
 #include "buff.h"
 #include "epd.h"
 #include "EPD_7in3e.h"
+#include "epd_frame.h"
+#include "epd_inflate.h"
+#include "epd_status.h"
+#include "epd_playlist.h"
+#include "mbedtls/sha256.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "device_state.h"
+#include "frame_store.h"
+#include "wake_timing.h"
 #include "GUI_Paint.h"
 #include "fonts.h"
 
@@ -36,8 +44,12 @@
 /* 云端API配置 */
 #define CLOUD_API_HOST "8.135.238.216"
 #define CLOUD_API_PORT 5000
+#define CLOUD_STR_(x) #x
+#define CLOUD_STR(x) CLOUD_STR_(x)
+#define CLOUD_API_BASE "http://" CLOUD_API_HOST ":" CLOUD_STR(CLOUD_API_PORT)
 #define CLOUD_API_TIMEOUT_MS 10000  // HTTP请求超时时间（10秒）
 #define CLOUD_DOWNLOAD_TIMEOUT_MS 60000  // 下载超时时间（60秒）
+#define CLOUD_RECV_IDLE_TIMEOUT_MS 5000  // 下载中连续这么久收不到数据视为断开
 
 /* 设备ID配置 */
 // 选择设备ID生成方式：
@@ -53,15 +65,53 @@
 // 避免“按键仍按下/引脚为低”导致刚入睡就立刻被再次唤醒
 #define WAKEUP_RELEASE_WAIT_MS 2500
 
-/* Flash临时存储配置 */
-#define FLASH_TEMP_FILE "/temp_image.bin"
+/* 刷新期间 Deep-sleep 配置 */
+// 1 = 发出刷新命令(0x12)后 MCU 立即深睡，醒来再提交版本号并让屏幕进入睡眠
+// 0 = 保持唤醒等待刷新完成（旧行为）
+#define EPD_REFRESH_DEEP_SLEEP 1
+// ESP32-C3 深睡只能由 GPIO0~5 唤醒，BUSY 接在 GPIO8，所以用定时唤醒后检查 BUSY
+#define EPD_REFRESH_FIRST_WAKE_MS 20000  // 首次唤醒：E6 整屏刷新约需 20s
+#define EPD_REFRESH_POLL_WAKE_MS  2000   // 仍在忙时的再次唤醒间隔
+#define EPD_REFRESH_MAX_POLLS     20     // 超过后不再等待，直接断电收尾
+#define EPD_REFRESH_PENDING_MAGIC 0x45504452UL  // "EPDR"
+
+/* Flash存储配置（帧分区见 frame_store.h） */
 // 7.3" E6: 800x480，每像素 4bit（a~p 编码为单字符），总字符数固定
 #define EPD_EXPECTED_CHARS 384000
+// 二进制帧（EPDF，见 epd_frame.h）：20 字节头 + 192000 字节 4bit 像素
+#define EPD_EXPECTED_BIN_SIZE (EPD_FRAME_HEADER_SIZE + EPD_EXPECTED_CHARS / 2)
+// 1 = 在 status 请求中声明支持二进制帧，由云端决定下发格式；0 = 只用 a~p 文本
+#define EPD_ACCEPT_BIN_FRAME 1
+// 1 = 同时声明支持按行 RLE 帧（大小随图片内容变化，由云端在 imageSize 中给出）
+#define EPD_ACCEPT_RLE_FRAME 1
+// 1 = 声明支持差分帧：显示成功的 bin 帧所在的槽保留为基准帧，之后云端只下发变化的行
+#define EPD_ACCEPT_DELTA_FRAME 1
+// 下载的接收缓冲和Flash写入批次都取一个擦除扇区
+#define EPD_DOWNLOAD_BUF_SIZE FRAME_SECTOR_SIZE   // 接收缓冲 4KB
+#define EPD_FLASH_WRITE_BATCH FRAME_SECTOR_SIZE   // 攒满一批再写，写入边界与槽内扇区对齐（每批先擦一个扇区）
+// 1 = 下载时声明 Accept-Encoding: deflate, gzip，边收边用 ROM tinfl 解压（见 epd_inflate.h）
+#define EPD_ACCEPT_COMPRESSED 1
+// 1 = 下载时直接解码写入屏幕显存，不写帧分区（省掉一次Flash写入和读回）；
+//     长度和 SHA-256 与云端声明一致才刷新，不一致则不刷新、保持原画面。
+//     直写模式不保存基准帧，差分帧仍走帧分区路径；默认关闭
+#define EPD_STREAM_TO_PANEL 0
+// 1 = 下载中断时保留已收到的部分（帧槽中的数据 + RTC 中的槽号/ETag/偏移），
+//     下次唤醒用 Range/If-Range 续传；云端文件已变化（ETag 不符）时从头下载
+#define EPD_RESUME_DOWNLOAD 1
+#define EPD_RESUME_MAGIC 0x45505253UL  // "EPRS"
+// 1 = 已绑定设备唤醒后先发一次条件 GET（If-None-Match: "v<本地版本>"）：
+//     304 直接回睡；200 的响应体就是新图片，同一个请求里下载完成。其他情况再走 status 流程
+#define EPD_CONDITIONAL_UPDATE 1
+// 1 = status 查询使用二进制协议（epd_status.h，POST /api/device/status/bin），
+//     云端不支持（404）时改用 JSON 接口
+#define EPD_BINARY_STATUS 1
+// 1 = 已绑定设备先检查激活的页面列表（epd_playlist.h，GET /api/device/<id>/playlist）：
+//     各页预取到帧分区，定时唤醒/短按GPIO0时不联网轮流显示，定时唤醒间隔改为每页显示时长；
+//     只在定时唤醒累计满 PLAYLIST_CHECK_MINUTES 后联网检查清单（If-None-Match）
+#define EPD_PLAYLIST 1
+#define PLAYLIST_CHECK_MINUTES (DEEP_SLEEP_INTERVAL_HOURS * 60)
 
-/* NVS 配置 */
-#define PREF_NAMESPACE "device"
-#define PREF_KEY_CLAIMED "claimed"
-#define PREF_KEY_IMG_VER "imgVer"
+/* NVS 配置（命名空间和键名）见 device_state.h */
 
 /* 全局图像缓冲区（用于显示设备码） */
 #define GLOBAL_IMAGE_BUFFER_WIDTH  400
@@ -74,16 +124,14 @@ UBYTE globalImageBuffer[GLOBAL_IMAGE_BUFFER_SIZE];
  *                               全局变量
  * ============================================================================ */
 
-extern Preferences preferences;  // NVS持久化存储（在Loader_esp32wf.ino中定义）
-
 String deviceId;
 bool deviceClaimed = false;
 int localImageVersion = 0;
 
-/* Flash临时文件 */
-File flashTempFile;
-bool flashTempFileOpen = false;
-int flashTempFileSize = 0;
+/* 下载中的帧：写入帧分区的一个空闲槽，显示成功后才成为当前帧（frame_store.h） */
+static int g_dlSlot = -1;        // 写入的槽（-1 = 还没有）
+static uint32_t g_dlBase = 0;    // 数据在槽内的起始偏移（差分帧为 FRAME_DELTA_OFFSET）
+static int g_dlSize = 0;         // 已写入的字节数
 
 /* ============================================================================
  *                          本次唤醒的“一次性”状态机
@@ -100,6 +148,14 @@ static bool g_shouldEnterDeepSleep = false;   // 本次唤醒是否应立即回
 static bool g_deepSleepRequested = false;     // 防止重复执行 deep-sleep 进入流程
 static int g_targetImageVersion = 0;          // 需要更新到的版本
 static String g_targetImageUrl = "";          // 需要下载的 URL
+static int g_targetImageFormat = EPD_FORMAT_TEXT;  // 云端下发的数据格式
+static int g_targetImageSize = 0;             // 云端声明的下载大小（字节，0=未知）
+static String g_targetImageSha256 = "";       // 云端声明的 SHA-256（下载后校验）
+static bool g_targetImagePrefetched = false;  // 条件 GET 已把新图片下载到帧槽
+static bool g_playlistShow = false;           // 本次唤醒显示播放列表的下一页（清单已检查）
+static String g_playlistTag;                  // 条件 GET 响应头 X-EPD-Playlist（空 = 云端没有给出）
+
+/* 刷新进行中的待完成工作 g_pendingRefresh 和续传信息 g_resume 在 RTC 内存中（device_state.h，冷启动后无效） */
 
 /* ============================================================================
  *                            辅助函数：设备ID
@@ -130,58 +186,81 @@ inline String getDeviceIdFromMac() {
  * ============================================================================ */
 
 /**
- * 读取本地持久化的claimed状态
+ * 读取本地持久化的claimed状态（RTC 中的副本，冷启动时已从 NVS 载入）
  */
 bool loadClaimedStatus() {
-    if (!preferences.begin(PREF_NAMESPACE, true)) {
-        preferences.end();
-        Serial.println("📖 读取本地绑定状态: 未绑定（首次使用）");
-        return false;
-    }
-    bool claimed = preferences.getBool(PREF_KEY_CLAIMED, false);
-    preferences.end();
+    bool claimed = g_devState.claimed != 0;
     Serial.printf("📖 读取本地绑定状态: %s\n", claimed ? "已绑定" : "未绑定");
     return claimed;
 }
 
 /**
- * 保存本地持久化的claimed状态
+ * 保存本地持久化的claimed状态（没有变化时不写 NVS）
+ * RTC 中的副本只在写入 NVS 成功后更新，两者不会不一致
+ * @return 是否已保存
  */
-void saveClaimedStatus(bool claimed) {
+bool saveClaimedStatus(bool claimed) {
+    if ((g_devState.claimed != 0) == claimed) {
+        return true;
+    }
     if (!preferences.begin(PREF_NAMESPACE, false)) {
         Serial.println("⚠️  NVS命名空间打开失败，无法保存绑定状态");
-        return;
+        return false;
     }
-    preferences.putBool(PREF_KEY_CLAIMED, claimed);
+    bool ok = preferences.putBool(PREF_KEY_CLAIMED, claimed) > 0;
     preferences.end();
+    if (!ok) {
+        Serial.println("⚠️  NVS写入失败，无法保存绑定状态");
+        return false;
+    }
+    g_devState.claimed = claimed;
     Serial.printf("💾 保存本地绑定状态: %s\n", claimed ? "已绑定" : "未绑定");
+    return true;
 }
 
 /**
  * 读取本地图片版本号
  */
 int loadImageVersion() {
-    if (!preferences.begin(PREF_NAMESPACE, true)) {
-        preferences.end();
-        return 0;
-    }
-    int version = preferences.getInt(PREF_KEY_IMG_VER, 0);
-    preferences.end();
-    Serial.printf("📖 读取本地图片版本: %d\n", version);
-    return version;
+    Serial.printf("📖 读取本地图片版本: %d\n", (int)g_devState.imageVersion);
+    return g_devState.imageVersion;
 }
 
 /**
- * 保存本地图片版本号
+ * 保存本地图片版本号（没有变化时不写 NVS）
+ * RTC 中的副本只在写入 NVS 成功后更新；失败时下次唤醒按旧版本重新检查
+ * @return 是否已保存
  */
-void saveImageVersion(int version) {
+bool saveImageVersion(int version) {
+    if (g_devState.imageVersion == version) {
+        return true;
+    }
     if (!preferences.begin(PREF_NAMESPACE, false)) {
         Serial.println("⚠️  NVS命名空间打开失败，无法保存图片版本");
-        return;
+        return false;
     }
-    preferences.putInt(PREF_KEY_IMG_VER, version);
+    bool ok = preferences.putInt(PREF_KEY_IMG_VER, version) > 0;
     preferences.end();
+    if (!ok) {
+        Serial.println("⚠️  NVS写入失败，无法保存图片版本");
+        return false;
+    }
+    g_devState.imageVersion = version;
     Serial.printf("💾 保存本地图片版本: %d\n", version);
+    return true;
+}
+
+/**
+ * 读取差分基准帧对应的图片版本号和 payload CRC32（帧槽表在 RTC 中有副本，不读 Flash）
+ * @return 没有基准帧时返回 0
+ */
+int loadBaseFrameVersion(uint32_t *crc) {
+    if (g_frames.base == FRAME_SLOT_NONE) {
+        *crc = 0;
+        return 0;
+    }
+    *crc = g_frames.slot[g_frames.base].crc;
+    return g_frames.slot[g_frames.base].version;
 }
 
 /* ============================================================================
@@ -189,61 +268,32 @@ void saveImageVersion(int version) {
  * ============================================================================ */
 
 /**
- * 初始化Flash存储（SPIFFS）
+ * 选择下载写入的槽：第一次写 Flash 时才查找帧分区，大多数唤醒以“已是最新”结束，不需要它
+ * @param format 响应头 X-EPD-Format（为空时按 g_targetImageFormat），差分帧写到槽的后半部分
  */
-bool initFlashStorage() {
-    Serial.println("📁 初始化SPIFFS文件系统...");
-    
-    if (!SPIFFS.begin(false)) {
-        Serial.println("⚠️  SPIFFS挂载失败，尝试格式化...");
-        if (!SPIFFS.format()) {
-            Serial.println("❌ SPIFFS格式化失败");
-            return false;
-        }
-        if (!SPIFFS.begin(false)) {
-            Serial.println("❌ SPIFFS重新挂载失败");
-            return false;
-        }
+static bool beginDownloadSlot(const String& format) {
+    if (!frameStoreInit()) {
+        return false;
     }
-    
-    Serial.println("✅ SPIFFS初始化成功");
-    size_t totalBytes = SPIFFS.totalBytes();
-    size_t usedBytes = SPIFFS.usedBytes();
-    Serial.printf("   总大小: %.2f KB, 已使用: %.2f KB, 可用: %.2f KB\n", 
-                  totalBytes / 1024.0, usedBytes / 1024.0, (totalBytes - usedBytes) / 1024.0);
-    
-    // 清除旧的临时文件
-    if (SPIFFS.exists(FLASH_TEMP_FILE)) {
-        SPIFFS.remove(FLASH_TEMP_FILE);
-        Serial.println("🗑️  已清除旧的临时文件");
+    // 优先沿用上次未完成下载的槽，减少 Flash 擦写的分散
+    g_dlSlot = frameSlotAcquire(g_resume.slot);
+    if (g_dlSlot < 0) {
+        Serial.println(g_frames.dirty ? "❌ 帧槽表仍未写回NVS，暂不写入新数据" : "❌ 没有空闲的帧槽");
+        return false;
     }
-    
-    flashTempFileOpen = false;
-    flashTempFileSize = 0;
+    bool delta = format.length() > 0 ? format == "delta" : g_targetImageFormat == EPD_FORMAT_DELTA;
+    g_dlBase = delta ? FRAME_DELTA_OFFSET : 0;
+    g_dlSize = 0;
     return true;
 }
 
 /**
- * 关闭Flash临时文件
+ * 放弃下载的数据（槽不在槽表中，内容无需擦除，下次写入时覆盖）
  */
-void closeFlashTempFile() {
-    if (flashTempFileOpen && flashTempFile) {
-        flashTempFile.close();
-        flashTempFileOpen = false;
-        Serial.printf("📁 Flash文件已关闭，总大小: %d 字节\n", flashTempFileSize);
-    }
-}
-
-/**
- * 清除Flash临时文件
- */
-void clearFlashTempFile() {
-    closeFlashTempFile();
-    if (SPIFFS.exists(FLASH_TEMP_FILE)) {
-        SPIFFS.remove(FLASH_TEMP_FILE);
-        Serial.println("🗑️  Flash临时文件已清除");
-    }
-    flashTempFileSize = 0;
+static void releaseDownloadSlot() {
+    g_dlSlot = -1;
+    g_dlBase = 0;
+    g_dlSize = 0;
 }
 
 /* ============================================================================
@@ -327,10 +377,89 @@ void displayDeviceCode() {
     UWORD ystart = (height - paintHeight) / 2;
     
     EPD_7IN3E_DisplayPart(imageBuffer, xstart, ystart, paintWidth, paintHeight);
+    // 屏幕上不再是当前帧，绑定后版本未变时从帧分区重显
+    frameTableSetStale(true);
     
     Serial.println("✅ 设备码已显示在屏幕上");
 }
 
+/* ============================================================================
+ *                            云端连接（每次唤醒复用）
+ * ============================================================================ */
+
+/*
+ * 本次唤醒的所有请求（条件 GET、status、下载）共用一个 WiFiClient，
+ * HTTPClient 开启 setReuse 后按 HTTP/1.1 keep-alive 复用已建立的 TCP 连接。
+ * 响应体没有读完（出错/中途放弃）的连接不能复用，用 cloudHttpEnd(http, false) 断开。
+ */
+static WiFiClient g_cloudClient;
+static String g_cloudHostPort = "";   // 当前连接的 "主机:端口"
+static int g_cloudConnections = 0;    // 本次唤醒新建的 TCP 连接数
+
+/**
+ * 取 URL 中的 "主机:端口"（未写端口时为 80）
+ */
+static String cloudHostPortOf(const String& url) {
+    int start = url.indexOf("://");
+    start = (start < 0) ? 0 : start + 3;
+    int end = url.indexOf('/', start);
+    String hostPort = url.substring(start, end < 0 ? url.length() : end);
+    if (hostPort.indexOf(':') < 0) {
+        hostPort += ":80";
+    }
+    return hostPort;
+}
+
+/**
+ * 用共享连接初始化 HTTPClient
+ * HTTPClient 复用连接时不检查主机，所以目标主机变化时先断开旧连接
+ */
+static bool cloudHttpBegin(HTTPClient& http, const String& url) {
+    String hostPort = cloudHostPortOf(url);
+    if (g_cloudClient.connected() && hostPort != g_cloudHostPort) {
+        g_cloudClient.stop();
+    }
+    g_cloudHostPort = hostPort;
+    http.setReuse(true);
+    return http.begin(g_cloudClient, url);
+}
+
+/**
+ * 发送请求；连接是复用的且已被云端关闭（发送失败/连接丢失）时，断开后在新连接上重试一次
+ * @param method "GET" / "POST"
+ * @return HTTP 状态码，< 0 为 HTTPClient 错误码
+ */
+static int cloudHttpSend(HTTPClient& http, const char *method, const uint8_t *body, size_t len) {
+    bool reused = g_cloudClient.connected();
+    if (!reused) {
+        g_cloudConnections++;
+    }
+    int httpCode = http.sendRequest(method, (uint8_t *)body, len);
+    if (reused && (httpCode == HTTPC_ERROR_SEND_HEADER_FAILED || httpCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+                   httpCode == HTTPC_ERROR_CONNECTION_LOST || httpCode == HTTPC_ERROR_NOT_CONNECTED)) {
+        Serial.println("   复用的连接已被云端关闭，重新连接");
+        g_cloudClient.stop();
+        g_cloudConnections++;
+        httpCode = http.sendRequest(method, (uint8_t *)body, len);
+    }
+    return httpCode;
+}
+
+static int cloudHttpSend(HTTPClient& http, const char *method, const String& body = "") {
+    return cloudHttpSend(http, method, (const uint8_t *)body.c_str(), body.length());
+}
+
+/**
+ * 结束请求
+ * @param reusable 响应体已完整读完，连接可留给下一个请求；否则断开
+ */
+static void cloudHttpEnd(HTTPClient& http, bool reusable) {
+    if (!reusable) {
+        g_cloudClient.stop();
+    }
+    http.end();
+}
+
 /* ============================================================================
  *                            云端API调用
  * ============================================================================ */
@@ -342,39 +471,132 @@ struct DeviceStatusResponse {
     bool success;
     bool claimed;
     int imageVersion;
-    String imageUrl;
-    String error;
+    char imageUrl[EPD_STATUS_MAX_URL + 1];
+    int imageFormat;   // EPD_FORMAT_TEXT / EPD_FORMAT_BIN / EPD_FORMAT_RLE
+    int imageSize;     // imageUrl 对应数据的字节数（0=云端未返回）
+    char imageSha256[65];  // imageUrl 对应数据的 SHA-256（十六进制，空=云端未返回）
+    char error[48];
 };
 
+#if EPD_BINARY_STATUS
+static bool g_binaryStatusUnsupported = false;  // 云端对二进制 status 返回过 404，本次唤醒不再尝试
+#endif
+
 /**
- * 向云端查询设备状态
+ * 设备支持的下载格式（位 1<<EPD_FORMAT_*）
+ * @param baseVersion 输出：有基准帧时为基准帧版本（同时声明 delta），否则为 0
+ * @param baseCrc 输出：基准帧 payload 的 CRC32
  */
-DeviceStatusResponse queryDeviceStatus() {
-    DeviceStatusResponse result = {false, false, 0, "", ""};
-    
-    if (WiFi.status() != WL_CONNECTED) {
-        result.error = "WiFi未连接";
-        return result;
+static uint8_t acceptedImageFormatMask(int *baseVersion, uint32_t *baseCrc) {
+    uint8_t mask = 1 << EPD_FORMAT_TEXT;
+#if EPD_ACCEPT_RLE_FRAME
+    mask |= 1 << EPD_FORMAT_RLE;
+#endif
+#if EPD_ACCEPT_BIN_FRAME
+    mask |= 1 << EPD_FORMAT_BIN;
+#endif
+    *baseVersion = 0;
+    *baseCrc = 0;
+#if EPD_ACCEPT_DELTA_FRAME
+    // 有基准帧时声明差分支持，云端核对版本和 CRC 后只下发变化的行
+    int version = loadBaseFrameVersion(baseCrc);
+    if (version > 0) {
+        mask |= 1 << EPD_FORMAT_DELTA;
+        *baseVersion = version;
+    } else {
+        *baseCrc = 0;
+    }
+#endif
+    return mask;
+}
+
+/**
+ * 设备支持的下载格式（逗号分隔，按优先顺序），JSON status 的 formats 和条件 GET 的 X-EPD-Formats 共用
+ * 参数同 acceptedImageFormatMask
+ */
+String acceptedImageFormats(int *baseVersion, uint32_t *baseCrc) {
+    // 旧云端会忽略该字段并继续下发 a~p 文本
+    uint8_t mask = acceptedImageFormatMask(baseVersion, baseCrc);
+    String formats;
+    if (mask & (1 << EPD_FORMAT_RLE)) {
+        formats += "rle,";
+    }
+    if (mask & (1 << EPD_FORMAT_BIN)) {
+        formats += "bin,";
     }
+    formats += "text";
+    if (mask & (1 << EPD_FORMAT_DELTA)) {
+        formats += ",delta";
+    }
+    return formats;
+}
+
+/**
+ * 输出 status 查询结果
+ */
+static void logDeviceStatus(const DeviceStatusResponse& result) {
+    Serial.printf("   绑定状态: %s\n", result.claimed ? "已绑定" : "未绑定");
+    Serial.printf("   图片版本: %d\n", result.imageVersion);
+    if (result.imageUrl[0] != '\0') {
+        Serial.printf("   图片URL: %s\n", result.imageUrl);
+        Serial.printf("   数据格式: %s\n", result.imageFormat == EPD_FORMAT_DELTA ? "差分帧" :
+                      (result.imageFormat == EPD_FORMAT_RLE ? "RLE帧" :
+                      (result.imageFormat == EPD_FORMAT_BIN ? "二进制帧" : "a~p文本")));
+    }
+}
+
+/**
+ * 向云端查询设备状态（JSON 接口）
+ */
+static DeviceStatusResponse queryDeviceStatusJson() {
+    DeviceStatusResponse result = {};
+    result.imageFormat = EPD_FORMAT_TEXT;
     
     HTTPClient http;
-    String url = "http://" + String(CLOUD_API_HOST) + ":" + String(CLOUD_API_PORT) + "/api/device/status";
+    const char *url = CLOUD_API_BASE "/api/device/status";
     
-    Serial.printf("📡 查询设备状态: %s\n", url.c_str());
+    Serial.printf("📡 查询设备状态: %s\n", url);
     
-    http.begin(url);
+    cloudHttpBegin(http, url);
     http.setTimeout(CLOUD_API_TIMEOUT_MS);
     http.addHeader("Content-Type", "application/json");
     
-    StaticJsonDocument<256> doc;
+    StaticJsonDocument<1024> doc;
     doc["deviceId"] = deviceId;
+    // 声明支持的下载格式；有基准帧时带上基准帧版本和 CRC
+    int baseVersion;
+    uint32_t baseCrc;
+    String accepted = acceptedImageFormats(&baseVersion, &baseCrc);
+    JsonArray formats = doc.createNestedArray("formats");
+    for (int start = 0; start < (int)accepted.length(); ) {
+        int end = accepted.indexOf(',', start);
+        if (end < 0) {
+            end = accepted.length();
+        }
+        formats.add(accepted.substring(start, end));
+        start = end + 1;
+    }
+    if (baseVersion > 0) {
+        doc["baseVersion"] = baseVersion;
+        doc["baseCrc"] = baseCrc;
+    }
+    // 之前几次唤醒的耗时记录（条件 GET 已上报的不再重复）
+    String timing = wakeTimingPending();
+    if (timing.length() > 0) {
+        doc["timing"] = timing;
+    }
     String requestBody;
     serializeJson(doc, requestBody);
     
-    int httpCode = http.POST(requestBody);
+    int httpCode = cloudHttpSend(http, "POST", requestBody);
+    bool bodyRead = false;
+    if (httpCode == HTTP_CODE_OK && timing.length() > 0) {
+        wakeTimingMarkUploaded();
+    }
     
     if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_CREATED) {
         String response = http.getString();
+        bodyRead = true;
         Serial.printf("✅ 云端响应: %s\n", response.c_str());
         
         StaticJsonDocument<1024> respDoc;
@@ -388,215 +610,1439 @@ DeviceStatusResponse queryDeviceStatus() {
                 result.imageVersion = respDoc["imageVersion"].as<int>();
             }
             
-            if (respDoc["imageUrl"].is<String>()) {
-                result.imageUrl = respDoc["imageUrl"].as<String>();
+            if (respDoc["imageUrl"].is<const char*>()) {
+                strlcpy(result.imageUrl, respDoc["imageUrl"].as<const char*>(), sizeof(result.imageUrl));
             }
-            
-            Serial.printf("   绑定状态: %s\n", result.claimed ? "已绑定" : "未绑定");
-            Serial.printf("   图片版本: %d\n", result.imageVersion);
-            if (result.imageUrl.length() > 0) {
-                Serial.printf("   图片URL: %s\n", result.imageUrl.c_str());
+
+            if (respDoc["imageFormat"].is<const char*>()) {
+                const char *fmt = respDoc["imageFormat"].as<const char*>();
+                if (strcmp(fmt, "bin") == 0) {
+                    result.imageFormat = EPD_FORMAT_BIN;
+                } else if (strcmp(fmt, "rle") == 0) {
+                    result.imageFormat = EPD_FORMAT_RLE;
+                } else if (strcmp(fmt, "delta") == 0) {
+                    result.imageFormat = EPD_FORMAT_DELTA;
+                }
             }
+            if (respDoc["imageSize"].is<int>()) {
+                result.imageSize = respDoc["imageSize"].as<int>();
+            }
+            if (respDoc["imageSha256"].is<const char*>()) {
+                strlcpy(result.imageSha256, respDoc["imageSha256"].as<const char*>(), sizeof(result.imageSha256));
+            }
+            
+            logDeviceStatus(result);
         } else {
-            result.error = "JSON解析失败";
+            strlcpy(result.error, "JSON解析失败", sizeof(result.error));
             Serial.printf("❌ JSON解析失败: %s\n", error.c_str());
         }
     } else {
-        result.error = "HTTP错误: " + String(httpCode);
+        snprintf(result.error, sizeof(result.error), "HTTP错误: %d", httpCode);
         Serial.printf("❌ HTTP错误: %d\n", httpCode);
         if (httpCode < 0) {
             Serial.printf("   错误详情: %s\n", http.errorToString(httpCode).c_str());
         }
     }
     
-    http.end();
+    cloudHttpEnd(http, bodyRead);
     return result;
 }
 
+#if EPD_BINARY_STATUS
+/**
+ * 向云端查询设备状态（二进制接口，见 epd_status.h）
+ * 请求在栈上打包，响应读进栈上缓冲区原地解析，不经过 JSON/String
+ * @return false 表示云端不支持二进制接口（404），调用方改用 JSON 接口
+ */
+static bool queryDeviceStatusBinary(DeviceStatusResponse *result) {
+    memset(result, 0, sizeof(*result));
+    result->imageFormat = EPD_FORMAT_TEXT;
+    
+    char timing[EPD_STATUS_MAX_TIMING + 1];
+    int timingLen = wakeTimingFormat(timing, sizeof(timing));
+    int baseVersion;
+    uint32_t baseCrc;
+    uint8_t mask = acceptedImageFormatMask(&baseVersion, &baseCrc);
+    uint8_t request[EPD_STATUS_REQ_HEADER + EPD_STATUS_MAX_TIMING];
+    int requestLen = EPD_statusPackRequest(request, sizeof(request), deviceId.c_str(), mask,
+                                           baseVersion, baseCrc, timing, timingLen);
+    if (requestLen < 0) {
+        strlcpy(result->error, "请求打包失败", sizeof(result->error));
+        return true;
+    }
+    
+    HTTPClient http;
+    Serial.println("📡 查询设备状态: " CLOUD_API_BASE "/api/device/status/bin");
+    cloudHttpBegin(http, CLOUD_API_BASE "/api/device/status/bin");
+    http.setTimeout(CLOUD_API_TIMEOUT_MS);
+    http.addHeader("Content-Type", "application/octet-stream");
+    
+    int httpCode = cloudHttpSend(http, "POST", request, requestLen);
+    if (httpCode == HTTP_CODE_NOT_FOUND) {
+        cloudHttpEnd(http, false);
+        Serial.println("ℹ️ 云端不支持二进制 status，改用 JSON");
+        return false;
+    }
+    if (httpCode != HTTP_CODE_OK) {
+        snprintf(result->error, sizeof(result->error), "HTTP错误: %d", httpCode);
+        Serial.printf("❌ HTTP错误: %d\n", httpCode);
+        cloudHttpEnd(http, false);
+        return true;
+    }
+    
+    uint8_t response[EPD_STATUS_MAX_RESP];
+    int len = http.getSize();
+    int got = 0;
+    if (len >= EPD_STATUS_RESP_HEADER && len <= (int)sizeof(response)) {
+        got = http.getStreamPtr()->readBytes(response, len);
+    }
+    EPD_StatusReply reply;
+    bool parsed = got == len && EPD_statusParseReply(response, len, &reply);
+    cloudHttpEnd(http, got == len);
+    if (!parsed) {
+        strlcpy(result->error, "二进制响应无效", sizeof(result->error));
+        Serial.printf("❌ 二进制响应无效（长度 %d，收到 %d）\n", len, got);
+        return true;
+    }
+    if (timingLen > 0) {
+        wakeTimingMarkUploaded();
+    }
+    
+    result->success = true;
+    result->claimed = (reply.flags & EPD_STATUS_F_CLAIMED) != 0;
+    result->imageVersion = (int)reply.imageVersion;
+    if (reply.flags & EPD_STATUS_F_HAS_IMAGE) {
+        memcpy(result->imageUrl, reply.url, reply.urlLen);
+        result->imageUrl[reply.urlLen] = '\0';
+        result->imageFormat = reply.format;
+        result->imageSize = (int)reply.imageSize;
+    }
+    if (reply.flags & EPD_STATUS_F_HAS_SHA) {
+        for (int i = 0; i < 32; i++) {
+            sprintf(result->imageSha256 + 2 * i, "%02x", reply.sha256[i]);
+        }
+    }
+    Serial.printf("✅ 云端响应: %d 字节\n", len);
+    logDeviceStatus(*result);
+    return true;
+}
+#endif
+
+/**
+ * 向云端查询设备状态
+ */
+DeviceStatusResponse queryDeviceStatus() {
+    DeviceStatusResponse result = {};
+    result.imageFormat = EPD_FORMAT_TEXT;
+    
+    if (WiFi.status() != WL_CONNECTED) {
+        strlcpy(result.error, "WiFi未连接", sizeof(result.error));
+        return result;
+    }
+#if EPD_BINARY_STATUS
+    if (!g_binaryStatusUnsupported) {
+        if (queryDeviceStatusBinary(&result)) {
+            return result;
+        }
+        g_binaryStatusUnsupported = true;
+    }
+#endif
+    return queryDeviceStatusJson();
+}
+
+/**
+ * 获取指定格式的期望下载大小（字节）
+ * @return RLE/差分帧大小取决于图片内容，返回 0 表示未知（下载后按帧头校验）
+ */
+int expectedImageSize(int format) {
+    if (format == EPD_FORMAT_RLE || format == EPD_FORMAT_DELTA) {
+        return 0;
+    }
+    return format == EPD_FORMAT_BIN ? EPD_EXPECTED_BIN_SIZE : EPD_EXPECTED_CHARS;
+}
+
+/**
+ * 根据槽内数据的开头计算期望大小（二进制帧按帧头，否则按 a~p 文本）
+ * @param offset 数据在槽内的起始偏移
+ * @param size 已写入的字节数
+ * @return 帧头无效时返回 -1
+ */
+static int frameExpectedSize(int slot, uint32_t offset, int size) {
+    uint8_t head[EPD_FRAME_HEADER_SIZE];
+    int headLen = size < (int)sizeof(head) ? size : (int)sizeof(head);
+    if (headLen <= 0 || !frameSlotRead(slot, offset, head, headLen) || !EPD_isFrame(head, headLen)) {
+        return EPD_EXPECTED_CHARS;
+    }
+    EPD_FrameHeader header;
+    if (!EPD_parseFrameHeader(head, headLen, &header)) {
+        return -1;
+    }
+    return header.headerLen + header.payloadLen;
+}
+
+/**
+ * 下载数据的 SHA-256：每收到一段就送入哈希，下载结束即可校验，不用再读一遍文件
+ * （ESP32-C3 上 mbedtls 的 SHA-256 由硬件 SHA 加速器完成）
+ */
+struct DownloadHash {
+    mbedtls_sha256_context ctx;
+    int64_t us;       // 累计哈希耗时（微秒）
+    uint32_t bytes;   // 已哈希的字节数
+};
+
+static void downloadHashBegin(DownloadHash *h) {
+    mbedtls_sha256_init(&h->ctx);
+    mbedtls_sha256_starts(&h->ctx, 0);
+    h->us = 0;
+    h->bytes = 0;
+}
+
+static void downloadHashUpdate(DownloadHash *h, const uint8_t *data, size_t len) {
+    int64_t t0 = esp_timer_get_time();
+    mbedtls_sha256_update(&h->ctx, data, len);
+    h->us += esp_timer_get_time() - t0;
+    h->bytes += len;
+}
+
+/**
+ * 结束哈希并与期望值比较，同时输出哈希耗时（每 MB）
+ * @param expectedHex 期望的 SHA-256（64 位十六进制，不区分大小写）
+ */
+static bool downloadHashMatches(DownloadHash *h, const String& expectedHex) {
+    uint8_t digest[32];
+    char hex[65];
+    int64_t t0 = esp_timer_get_time();
+    mbedtls_sha256_finish(&h->ctx, digest);
+    mbedtls_sha256_free(&h->ctx);
+    h->us += esp_timer_get_time() - t0;
+    for (int i = 0; i < 32; i++) {
+        sprintf(hex + 2 * i, "%02x", digest[i]);
+    }
+    bool ok = expectedHex.equalsIgnoreCase(hex);
+    Serial.printf("   SHA-256: %s（%u 字节，耗时 %.1f ms，%.2f ms/MB）\n", ok ? "一致" : "不符",
+                  (unsigned)h->bytes, h->us / 1000.0,
+                  h->bytes > 0 ? h->us * 1048576.0 / 1000.0 / h->bytes : 0.0);
+    if (!ok) {
+        Serial.printf("   期望 %s\n   实际 %s\n", expectedHex.c_str(), hex);
+    }
+    return ok;
+}
+
+/**
+ * httpDownload 的续传参数和响应信息
+ */
+struct HttpDownloadInfo {
+    int offset;          // 输入：续传起点（> 0 时发送 Range/If-Range，不请求压缩）
+    String ifRange;      // 输入：续传时的 ETag
+    String ifNoneMatch;  // 输入：条件请求的 ETag（云端返回 304 时不下载）
+    String formats;      // 输入：请求头 X-EPD-Formats（条件 GET 由云端选择格式）
+    String base;         // 输入：请求头 X-EPD-Base（"<基准帧版本>:<CRC>"）
+    String timing;       // 输入：请求头 X-EPD-Timing（未上报的唤醒耗时记录，见 wake_timing.h）
+    int playlistMax;     // 输入：请求头 X-EPD-Playlist-Max（> 0 时云端在 X-EPD-Playlist 中告知激活的列表）
+    int httpCode;        // 输出：HTTP 状态码
+    bool resumed;        // 输出：云端返回 206，数据从 offset 开始；否则从头开始
+    String sha256;       // 输出：响应头 X-EPD-SHA256（云端对完整数据计算的哈希）
+    String resumeEtag;   // 输出：响应头 X-EPD-Resume-ETag（空表示云端不支持续传）
+    int version;         // 输出：响应头 X-EPD-Version（条件 GET）
+    String format;       // 输出：响应头 X-EPD-Format
+    int bytes;           // 输出：响应头 X-EPD-Bytes（解压后的字节数，0=未给出）
+    String url;          // 输出：响应头 X-EPD-Url（同一数据的固定下载地址，续传用）
+    String playlist;     // 输出：响应头 X-EPD-Playlist（"l<listId>" 或 none；304/204 时同样给出）
+};
+
+/**
+ * 写入帧槽时 sink 的上下文
+ */
+struct FlashSinkCtx {
+    int limit;           // 解压后允许的最大字节数（<= 0 时只受槽大小限制），超过立即中止
+    DownloadHash hash;
+    HttpDownloadInfo *info;
+    bool started;        // 已收到第一段数据
+    bool overflow;       // 因超出 limit 中止（数据异常，不可续传）
+    uint8_t *batch;      // 写入批次缓冲（EPD_FLASH_WRITE_BATCH，分配失败时为空，直接写）
+    int batchFill;       // 批次缓冲中尚未写入的字节数
+};
+
+/**
+ * 把批次缓冲写入帧槽（批次在槽内的位置由已写入的字节数决定）
+ * @return 全部写入成功
+ */
+static bool flashSinkFlush(FlashSinkCtx *c) {
+    if (c->batchFill == 0) {
+        return true;
+    }
+    bool ok = frameSlotWrite(g_dlSlot, g_dlBase + g_dlSize - c->batchFill, c->batch, c->batchFill);
+    c->batchFill = 0;
+    return ok;
+}
+
+/**
+ * 下载（解压后）数据写入帧槽，同时计算 SHA-256
+ * 请求续传但云端返回了完整数据（200）时，从槽内数据的起点重新写
+ */
+static bool downloadSlotSink(const uint8_t *data, size_t len, void *ctx) {
+    FlashSinkCtx *c = (FlashSinkCtx *)ctx;
+    if (!c->started) {
+        c->started = true;
+        if (c->info->offset > 0 && !c->info->resumed) {
+            Serial.println("   云端文件已变化，从头下载");
+            g_dlSize = 0;
+            c->batchFill = 0;
+            mbedtls_sha256_free(&c->hash.ctx);
+            downloadHashBegin(&c->hash);
+        }
+        // 从头下载时收到第一段数据才查找帧分区、选择写入的槽
+        if (g_dlSlot < 0 && !beginDownloadSlot(c->info->format)) {
+            return false;
+        }
+    }
+    int room = FRAME_SLOT_SIZE - (int)g_dlBase - g_dlSize;
+    if ((c->limit > 0 && g_dlSize + (int)len > c->limit) || (int)len > room) {
+        c->overflow = true;
+        return false;
+    }
+    downloadHashUpdate(&c->hash, data, len);
+    if (!c->batch) {
+        bool ok = frameSlotWrite(g_dlSlot, g_dlBase + g_dlSize, data, len);
+        g_dlSize += len;
+        return ok;
+    }
+    // 按槽内偏移攒批：续传时的第一批只补齐到扇区边界，之后每批都是整扇区
+    while (len > 0) {
+        int batchRoom = EPD_FLASH_WRITE_BATCH - (g_dlSize % EPD_FLASH_WRITE_BATCH);
+        int n = (int)len < batchRoom ? (int)len : batchRoom;
+        memcpy(c->batch + c->batchFill, data, n);
+        c->batchFill += n;
+        g_dlSize += n;
+        data += n;
+        len -= n;
+        if (n == batchRoom && !flashSinkFlush(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * 解析响应头 Content-Encoding
+ * @return EPD_ENCODING_*，不支持的编码返回 -1
+ */
+static int parseContentEncoding(String enc) {
+    enc.trim();
+    enc.toLowerCase();
+    if (enc.length() == 0 || enc == "identity") {
+        return EPD_ENCODING_IDENTITY;
+    }
+    if (enc == "deflate") {
+        return EPD_ENCODING_DEFLATE;
+    }
+    if (enc == "gzip" || enc == "x-gzip") {
+        return EPD_ENCODING_GZIP;
+    }
+    return -1;
+}
+
+/**
+ * 等待下载连接可读（阻塞在套接字上，不轮询）
+ * @param timeoutMs 最长等待时间
+ * @return 1 = 有数据可读（或对端已关闭，read 会返回 0），0 = 超时，-1 = 连接已失效
+ */
+static int waitStreamReadable(WiFiClient *stream, unsigned long timeoutMs) {
+    if (stream->available() > 0) {
+        return 1;  // WiFiClient 内部缓冲里还有数据
+    }
+    int fd = stream->fd();
+    if (fd < 0) {
+        return -1;
+    }
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(fd, &readSet);
+    struct timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    int ret = select(fd + 1, &readSet, NULL, NULL, &tv);
+    return ret < 0 ? -1 : (ret > 0 ? 1 : 0);
+}
+
+/**
+ * 把收到的一段数据交给 sink（压缩传输时先解压）
+ */
+static bool downloadDeliver(EPD_Inflater *inflater, int encoding, const uint8_t *data, int len,
+                            EPD_InflateSink sink, void *ctx) {
+    if (encoding == EPD_ENCODING_IDENTITY) {
+        if (!sink(data, len, ctx)) {
+            Serial.println("❌ 数据写入失败或超出期望大小");
+            return false;
+        }
+    } else if (!EPD_inflateFeed(inflater, data, len, sink, ctx)) {
+        Serial.println("❌ 解压失败：数据损坏或解压后超出期望大小");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * HTTP GET 并把响应数据（压缩传输时为解压后的数据）分段交给 sink
+ * 下载到Flash和直写屏幕共用这一个接收循环
+ * @param url 下载URL
+ * @param expectedSize 期望的数据大小（字节，指解压后）；> 0 时云端返回的 Content-Length 不符直接失败
+ * @param sink 数据输出回调，返回 false 中止下载
+ * @param info 非空时：offset > 0 则续传（Range/If-Range），并输出 X-EPD-SHA256 等响应信息
+ * @return 交给 sink 的总字节数（续传时不含 offset 之前的部分）；HTTP/解压失败或 sink 中止时返回 -1
+ */
+static int httpDownload(const String& url, int expectedSize, EPD_InflateSink sink, void *ctx,
+                        HttpDownloadInfo *info = nullptr) {
+    int offset = info ? info->offset : 0;
+    HTTPClient http;
+    if (!cloudHttpBegin(http, url)) {
+        Serial.println("❌ HTTP begin失败");
+        return -1;
+    }
+    
+    http.setTimeout(CLOUD_DOWNLOAD_TIMEOUT_MS);
+    http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+    if (offset > 0) {
+        // 续传：按原文件字节范围请求（已保存的是解压后的数据，即原文件的前缀），云端不压缩
+        http.addHeader("Range", "bytes=" + String(offset) + "-");
+        http.addHeader("If-Range", info->ifRange);
+        Serial.printf("   续传: 从 %d 字节开始\n", offset);
+    }
+#if EPD_ACCEPT_COMPRESSED
+    else {
+        // HTTPClient 自带一条 "Accept-Encoding: identity;q=1,..." 头，云端会与这条合并解析
+        http.addHeader("Accept-Encoding", "deflate, gzip");
+        http.addHeader("X-EPD-Inflate-Window", String(EPD_INFLATE_WINDOW_BITS));
+    }
+#endif
+    if (info && info->ifNoneMatch.length() > 0) {
+        http.addHeader("If-None-Match", info->ifNoneMatch);
+    }
+    if (info && info->formats.length() > 0) {
+        http.addHeader("X-EPD-Formats", info->formats);
+    }
+    if (info && info->base.length() > 0) {
+        http.addHeader("X-EPD-Base", info->base);
+    }
+    if (info && info->timing.length() > 0) {
+        http.addHeader("X-EPD-Timing", info->timing);
+    }
+    if (info && info->playlistMax > 0) {
+        http.addHeader("X-EPD-Playlist-Max", String(info->playlistMax));
+    }
+    const char *responseHeaders[] = { "Content-Encoding", "X-EPD-SHA256", "X-EPD-Resume-ETag", "Content-Range",
+                                      "X-EPD-Version", "X-EPD-Format", "X-EPD-Bytes", "X-EPD-Url", "X-EPD-Playlist" };
+    http.collectHeaders(responseHeaders, 9);
+    
+    int httpCode = cloudHttpSend(http, "GET");
+    Serial.printf("   HTTP状态码: %d\n", httpCode);
+    if (info) {
+        info->httpCode = httpCode;
+        info->playlist = http.header("X-EPD-Playlist");
+    }
+    
+    bool resumed = (offset > 0 && httpCode == HTTP_CODE_PARTIAL_CONTENT);
+    if (httpCode == HTTP_CODE_NOT_MODIFIED || httpCode == HTTP_CODE_NO_CONTENT) {
+        cloudHttpEnd(http, true);  // 没有响应体，连接可以继续用
+        return -1;
+    }
+    if (httpCode != HTTP_CODE_OK && !resumed) {
+        Serial.printf("❌ HTTP下载失败: %d\n", httpCode);
+        cloudHttpEnd(http, false);
+        return -1;
+    }
+    // 206 的 Content-Range 必须从请求的位置开始（"bytes <offset>-<end>/<total>"），否则放弃续传
+    if (resumed && !http.header("Content-Range").startsWith("bytes " + String(offset) + "-")) {
+        Serial.printf("❌ Content-Range 不符: %s\n", http.header("Content-Range").c_str());
+        info->ifRange = "";
+        cloudHttpEnd(http, false);
+        return -1;
+    }
+    
+    int contentLength = http.getSize();
+    Serial.printf("   内容长度: %d 字节 (%.2f KB)\n", contentLength, contentLength / 1024.0);
+    
+    if (info) {
+        info->resumed = resumed;
+        info->sha256 = http.header("X-EPD-SHA256");
+        info->resumeEtag = http.header("X-EPD-Resume-ETag");
+        info->version = http.header("X-EPD-Version").toInt();
+        info->format = http.header("X-EPD-Format");
+        info->bytes = http.header("X-EPD-Bytes").toInt();
+        info->url = http.header("X-EPD-Url");
+    }
+    if (resumed && expectedSize > 0) {
+        expectedSize -= offset;
+    }
+    
+    int encoding = parseContentEncoding(http.header("Content-Encoding"));
+    if (encoding < 0) {
+        Serial.printf("❌ 不支持的 Content-Encoding: %s\n", http.header("Content-Encoding").c_str());
+        cloudHttpEnd(http, false);
+        return -1;
+    }
+    
+    EPD_Inflater inflater = {};
+    if (encoding != EPD_ENCODING_IDENTITY) {
+        Serial.printf("   压缩传输: %s（解压窗口 %d 字节）\n",
+                      encoding == EPD_ENCODING_GZIP ? "gzip" : "deflate", EPD_INFLATE_WINDOW);
+        if (!EPD_inflateBegin(&inflater, encoding)) {
+            Serial.printf("❌ 解压缓冲区分配失败，剩余内存 %d 字节\n", ESP.getFreeHeap());
+            cloudHttpEnd(http, false);
+            return -1;
+        }
+    }
+
+    // 设备端最小防护：如果云端返回了 Content-Length，但不是期望长度，直接判失败
+    // 这样可以避免把“坏/半截数据”交给 EPD 驱动，导致 busy 卡死
+    // （压缩传输时 Content-Length 是压缩后的长度，改为下载后检查解压长度）
+    if (encoding == EPD_ENCODING_IDENTITY && expectedSize > 0 && contentLength > 0 && contentLength != expectedSize) {
+        Serial.printf("❌ 内容长度异常，期望 %d，实际 %d，放弃下载\n", expectedSize, contentLength);
+        cloudHttpEnd(http, false);
+        return -1;
+    }
+    
+    // 流式接收：等套接字可读再读，读满整页的缓冲再交给 sink
+    uint8_t prevPhase = wakeTimingSwitch(WAKE_PHASE_DOWNLOAD);
+    WiFiClient *stream = http.getStreamPtr();
+    uint8_t *buffer = (uint8_t *)malloc(EPD_DOWNLOAD_BUF_SIZE);
+    if (!buffer) {
+        Serial.println("❌ 接收缓冲分配失败");
+        cloudHttpEnd(http, false);
+        EPD_inflateEnd(&inflater);
+        wakeTimingSwitch(prevPhase);
+        return -1;
+    }
+    int totalRead = 0;  // 收到的字节数（压缩传输时为压缩后的字节数）
+    int fill = 0;       // 缓冲中尚未交给 sink 的字节数
+    int lastReport = 0;
+    bool failed = false;
+    unsigned long startTime = millis();
+    
+    while (!failed && (contentLength > 0 || contentLength == -1)) {
+        unsigned long elapsed = millis() - startTime;
+        if (elapsed > CLOUD_DOWNLOAD_TIMEOUT_MS) {
+            Serial.println("❌ 下载超时！");
+            break;
+        }
+        unsigned long waitMs = CLOUD_DOWNLOAD_TIMEOUT_MS - elapsed;
+        int ready = waitStreamReadable(stream, waitMs < CLOUD_RECV_IDLE_TIMEOUT_MS ? waitMs : CLOUD_RECV_IDLE_TIMEOUT_MS);
+        if (ready <= 0) {
+            if (ready == 0) {
+                Serial.printf("❌ %d ms 内没有收到数据\n", CLOUD_RECV_IDLE_TIMEOUT_MS);
+            }
+            break;
+        }
+        
+        // 已知长度时不多读，避免读进同一连接上的下一个响应
+        int want = EPD_DOWNLOAD_BUF_SIZE - fill;
+        if (contentLength > 0 && want > contentLength) {
+            want = contentLength;
+        }
+        int bytesRead = stream->read(buffer + fill, want);
+        if (bytesRead <= 0) {
+            if (!stream->connected()) {
+                break;  // 对端关闭（未知长度的响应以此结束）
+            }
+            continue;
+        }
+        fill += bytesRead;
+        totalRead += bytesRead;
+        if (contentLength > 0) {
+            contentLength -= bytesRead;
+        }
+        // 如果 contentLength 未知（-1），但我们已经达到期望长度，也直接结束（防止超读）
+        bool done = contentLength == 0 ||
+                    (encoding == EPD_ENCODING_IDENTITY && contentLength == -1 && expectedSize > 0 && totalRead >= expectedSize);
+        if (fill < EPD_DOWNLOAD_BUF_SIZE && !done) {
+            continue;
+        }
+        
+        failed = !downloadDeliver(&inflater, encoding, buffer, fill, sink, ctx);
+        fill = 0;
+        
+        // 每64KB输出一次进度
+        if (totalRead - lastReport >= 65536) {
+            lastReport = totalRead;
+            Serial.printf("   已下载: %.2f KB\n", totalRead / 1024.0);
+        }
+        if (done) {
+            break;
+        }
+    }
+    // 中途断开：已收到的部分也交给 sink（续传需要完整的前缀）
+    if (!failed && fill > 0) {
+        failed = !downloadDeliver(&inflater, encoding, buffer, fill, sink, ctx);
+    }
+    free(buffer);
+    wakeTimingSwitch(prevPhase);
+    
+    unsigned long recvMs = millis() - startTime;
+    Serial.printf("   接收 %d 字节，用时 %lu ms，%.1f KB/s\n", totalRead, recvMs,
+                  recvMs > 0 ? totalRead * 1000.0 / 1024.0 / recvMs : 0.0);
+    
+    // 响应体读完的连接留给下一个请求（未知长度的响应以断开连接结束，不能复用）
+    cloudHttpEnd(http, !failed && contentLength == 0);
+    
+    int delivered = totalRead;
+    if (encoding != EPD_ENCODING_IDENTITY) {
+        if (!failed && !EPD_inflateFinish(&inflater)) {
+            Serial.println("❌ 压缩数据不完整或校验失败");
+            failed = true;
+        }
+        Serial.printf("   压缩数据: %d 字节 -> 解压 %u 字节（%.1f 倍）\n", totalRead,
+                      (unsigned)inflater.outBytes, totalRead > 0 ? inflater.outBytes / (float)totalRead : 0.0f);
+        delivered = inflater.outBytes;
+        EPD_inflateEnd(&inflater);
+    }
+    return failed ? -1 : delivered;
+}
+
+#if EPD_RESUME_DOWNLOAD
+/**
+ * 检查能否续传：RTC 中的续传信息属于同一个 URL，且记录的槽仍然空闲（未被当前帧/基准帧/播放列表引用）
+ * 可以续传时设置 g_dlSlot/g_dlBase
+ * @return 可续传的字节数；0 表示需要从头下载
+ */
+static int resumableDownloadSize(const String& imageUrl, int expectedSize) {
+    if (g_resume.magic != EPD_RESUME_MAGIC) {
+        return 0;
+    }
+    // 先打开存储再作废续传信息：初始化期间续传记录仍有效，已收到的部分不会被当作无主数据清理
+    bool storeOk = frameStoreInit();
+    g_resume.magic = 0;  // 续传信息只用一次，本次仍未完成时重新记录
+    if (g_resume.urlCrc != esp_rom_crc32_le(0, (const uint8_t *)imageUrl.c_str(), imageUrl.length())) {
+        Serial.println("   未完成的下载属于其他版本，放弃续传");
+        return 0;
+    }
+    if (!storeOk) {
+        return 0;
+    }
+    int slot = g_resume.slot;
+    int size = g_resume.offset;
+    uint32_t base = g_targetImageFormat == EPD_FORMAT_DELTA ? FRAME_DELTA_OFFSET : 0;
+    if (slot >= g_frameSlotCount || frameSlotPinned(slot) ||
+        size <= 0 || size > (int)(FRAME_SLOT_SIZE - base) || (expectedSize > 0 && size >= expectedSize)) {
+        Serial.printf("   续传记录（槽 %d，%d 字节）已失效，放弃续传\n", slot, size);
+        return 0;
+    }
+    g_dlSlot = slot;
+    g_dlBase = base;
+    return size;
+}
+
+/**
+ * 续传前把已保存的部分重新送入哈希（直接在映射的 Flash 上计算）
+ */
+static bool hashDownloadPrefix(DownloadHash *hash, int size) {
+    esp_partition_mmap_handle_t map;
+    const uint8_t *data = frameSlotMap(g_dlSlot, g_dlBase, size, &map);
+    if (!data) {
+        return false;
+    }
+    downloadHashUpdate(hash, data, size);
+    frameSlotUnmap(map);
+    return true;
+}
+#endif
+
 /**
- * 流式下载图片数据到SPIFFS（不占用大量RAM）
+ * 流式下载图片数据到帧分区的空闲槽（不占用大量RAM）
+ * 云端返回压缩数据时边收边解压，Flash中保存的始终是解压后的数据
+ * 中断时保留已收到的部分，下次唤醒对同一 URL 续传（EPD_RESUME_DOWNLOAD）
  * @param imageUrl 图片下载URL
- * @return 下载是否成功
+ * @param expectedSize 期望的数据大小（字节，指解压后），不匹配视为失败；<= 0 表示未知，下载后按帧头校验
+ * @param sha256Hex status 返回的 SHA-256；响应头 X-EPD-SHA256 优先。两者都没有时只校验长度
+ * @param info 非空时带上其中的条件请求头，并输出响应信息（见 HttpDownloadInfo）
+ * @return 下载是否成功（g_dlSlot/g_dlSize 指向数据；哈希不符也视为失败，数据已丢弃；304/204 返回 false）
  */
-bool downloadImageToFlash(const String& imageUrl) {
+bool downloadImageToFlash(const String& imageUrl, int expectedSize = EPD_EXPECTED_CHARS, const String& sha256Hex = "",
+                          HttpDownloadInfo *info = nullptr) {
     Serial.println("\n========== 开始下载图片 ==========");
     Serial.printf("   URL: %s\n", imageUrl.c_str());
     Serial.printf("   剩余内存: %d 字节\n", ESP.getFreeHeap());
     
-    // 清除旧文件并创建新文件
-    if (SPIFFS.exists(FLASH_TEMP_FILE)) {
-        SPIFFS.remove(FLASH_TEMP_FILE);
+    HttpDownloadInfo localInfo = {};
+    FlashSinkCtx sinkCtx = {};
+    sinkCtx.limit = expectedSize;
+    sinkCtx.info = info ? info : &localInfo;
+    downloadHashBegin(&sinkCtx.hash);
+    sinkCtx.batch = (uint8_t *)malloc(EPD_FLASH_WRITE_BATCH);
+    
+    int offset = 0;
+#if EPD_RESUME_DOWNLOAD
+    offset = resumableDownloadSize(imageUrl, expectedSize);
+    if (offset > 0 && !hashDownloadPrefix(&sinkCtx.hash, offset)) {
+        mbedtls_sha256_free(&sinkCtx.hash.ctx);
+        downloadHashBegin(&sinkCtx.hash);
+        releaseDownloadSlot();
+        offset = 0;
+    }
+    sinkCtx.info->offset = offset;
+    // 只有真正续传时才带校验值；从头下载时清空，新的续传记录只用这次响应给出的 ETag
+    sinkCtx.info->ifRange = offset > 0 ? String(g_resume.etag) : String();
+#endif
+    
+    // 续传时接着写已保存的部分；从头下载时等收到第一段数据再选槽（downloadSlotSink），
+    // 条件 GET 返回 304/204 时不碰 Flash
+    g_dlSize = offset;
+    
+    int delivered = httpDownload(imageUrl, expectedSize, downloadSlotSink, &sinkCtx, sinkCtx.info);
+    
+    // 写出最后不满一批的数据；写入失败时按下载失败处理（丢弃数据，不记录续传）
+    if (sinkCtx.batch && !flashSinkFlush(&sinkCtx)) {
+        Serial.println("❌ 写入帧分区失败");
+        delivered = -1;
+        sinkCtx.overflow = true;
+    }
+    free(sinkCtx.batch);
+    
+    // 条件请求：已是最新版本（304）或云端没有可下载的图片（204）
+    if (sinkCtx.info->httpCode == HTTP_CODE_NOT_MODIFIED || sinkCtx.info->httpCode == HTTP_CODE_NO_CONTENT) {
+        releaseDownloadSlot();
+        mbedtls_sha256_free(&sinkCtx.hash.ctx);
+        Serial.printf("   云端返回 %d，无需下载\n", sinkCtx.info->httpCode);
+        return false;
+    }
+    
+    // 请求续传但云端回了不带数据的 200：已保存的部分属于旧文件，不能再用
+    if (offset > 0 && !sinkCtx.started && !sinkCtx.info->resumed && sinkCtx.info->resumeEtag.length() > 0) {
+        releaseDownloadSlot();
+    }
+    
+    // 大小未知：用响应头 X-EPD-Bytes，没有时（RLE 帧）按下载到的帧头计算
+    if (expectedSize <= 0 && sinkCtx.info->bytes > 0) {
+        expectedSize = sinkCtx.info->bytes;
+    }
+    if (expectedSize <= 0 && g_dlSlot >= 0) {
+        expectedSize = frameExpectedSize(g_dlSlot, g_dlBase, g_dlSize);
+    }
+    
+    // 检查下载结果
+    Serial.printf("✅ 下载完成: %d 字节 (%.2f KB)，帧槽 %d\n", g_dlSize, g_dlSize / 1024.0, g_dlSlot);
+    Serial.printf("   期望大小: %d 字节\n", expectedSize);
+
+#if EPD_RESUME_DOWNLOAD
+    // 中途断开（超时/断网/压缩流被截断）：已写入的都是数据前缀，保留并记下槽号和 ETag，下次唤醒续传
+    // 没收到响应时沿用原来的 ETag；数据超长或 Content-Range 不符时不保留
+    // 条件 GET 的地址不带版本，续传记录改用响应头 X-EPD-Url 给出的固定地址（status 下发的也是它）
+    String etag = sinkCtx.info->resumeEtag.length() > 0 ? sinkCtx.info->resumeEtag : sinkCtx.info->ifRange;
+    const String& resumeUrl = sinkCtx.info->url.length() > 0 ? sinkCtx.info->url : imageUrl;
+    if (g_dlSlot >= 0 && g_dlSize > 0 && g_dlSize < expectedSize && !sinkCtx.overflow &&
+        etag.length() > 0 && etag.length() < sizeof(g_resume.etag)) {
+        g_resume.magic = EPD_RESUME_MAGIC;
+        g_resume.urlCrc = esp_rom_crc32_le(0, (const uint8_t *)resumeUrl.c_str(), resumeUrl.length());
+        g_resume.offset = g_dlSize;
+        g_resume.slot = g_dlSlot;
+        strcpy(g_resume.etag, etag.c_str());
+        mbedtls_sha256_free(&sinkCtx.hash.ctx);
+        Serial.printf("⚠️  下载中断：已保存 %d / %d 字节，下次唤醒续传\n", g_dlSize, expectedSize);
+        Serial.println("========== 下载未完成 ==========\n");
+        return false;
+    }
+#endif
+
+    // 设备端最小防护：只要不是“完全匹配”（解压不完整/校验失败也算），就视为失败并丢弃数据
+    if (delivered < 0 || g_dlSize != expectedSize) {
+        Serial.printf("❌ 下载不完整：期望 %d，实际 %d，丢弃数据并放弃本次刷新\n",
+                      expectedSize, g_dlSize);
+        releaseDownloadSlot();
+        mbedtls_sha256_free(&sinkCtx.hash.ctx);
+        Serial.println("========== 下载失败 ==========\n");
+        return false;
+    }
+    
+    // 哈希与数据同步计算完成，这里只比较结果：不一致则不提交（丢弃数据）
+    const String& expectedSha256 = sinkCtx.info->sha256.length() == 64 ? sinkCtx.info->sha256 : sha256Hex;
+    if (expectedSha256.length() == 0) {
+        Serial.println("   云端未提供 SHA-256，仅校验长度");
+        mbedtls_sha256_free(&sinkCtx.hash.ctx);
+    } else if (!downloadHashMatches(&sinkCtx.hash, expectedSha256)) {
+        Serial.println("❌ SHA-256 校验失败，丢弃数据并放弃本次刷新");
+        releaseDownloadSlot();
+        Serial.println("========== 下载失败 ==========\n");
+        return false;
     }
     
-    flashTempFile = SPIFFS.open(FLASH_TEMP_FILE, "w");
-    if (!flashTempFile) {
-        Serial.println("❌ 无法创建Flash临时文件");
+    Serial.println("========== 下载完成 ==========\n");
+    return true;
+}
+
+#if EPD_STREAM_TO_PANEL
+/**
+ * 直写屏幕时 sink 的上下文：解码器 + 整个下载数据的 SHA-256 和长度
+ */
+struct PanelStreamCtx {
+    EPD_StreamLoader loader;
+    DownloadHash hash;
+    int limit;    // 允许的最大字节数（云端声明的大小）
+    int total;    // 已收到的字节数（解压后）
+};
+
+static bool panelStreamSink(const uint8_t *data, size_t len, void *ctx) {
+    PanelStreamCtx *p = (PanelStreamCtx *)ctx;
+    if (p->total + (int)len > p->limit) {
+        return false;
+    }
+    p->total += len;
+    downloadHashUpdate(&p->hash, data, len);
+    return EPD_7in3E_streamFeed(&p->loader, data, len);
+}
+
+/**
+ * 下载图片并直接写入屏幕显存，不经过帧分区
+ * 只有长度等于云端声明的 imageSize 且 SHA-256 一致（响应头 X-EPD-SHA256 优先，否则 imageSha256）时才刷新；
+ * 否则不刷新（屏幕显示的仍是原画面），返回 false
+ * @param imageUrl 图片下载URL
+ * @param expectedSize 云端声明的数据大小（字节，解压后）
+ * @param sha256Hex 云端声明的 SHA-256（64 位小写十六进制）
+ * @return 是否已发出刷新
+ */
+bool streamImageToPanel(const String& imageUrl, int expectedSize, const String& sha256Hex) {
+    Serial.println("\n========== 开始下载图片（直写屏幕） ==========");
+    Serial.printf("   URL: %s\n", imageUrl.c_str());
+    Serial.printf("   剩余内存: %d 字节\n", ESP.getFreeHeap());
+    
+    if (expectedSize <= 0 || sha256Hex.length() != 64) {
+        Serial.println("❌ 云端未声明大小或 SHA-256，不能直写屏幕");
+        return false;
+    }
+    
+    PanelStreamCtx *p = (PanelStreamCtx *)malloc(sizeof(PanelStreamCtx));
+    if (!p) {
+        Serial.println("❌ 内存不足");
+        return false;
+    }
+    p->limit = expectedSize;
+    p->total = 0;
+    if (!EPD_7in3E_streamBegin(&p->loader)) {
+        free(p);
+        return false;
+    }
+    downloadHashBegin(&p->hash);
+    
+    HttpDownloadInfo info = {};
+    int delivered = httpDownload(imageUrl, expectedSize, panelStreamSink, p, &info);
+    
+    bool sizeOk = delivered == expectedSize;
+    Serial.printf("   接收: %d 字节，期望 %d 字节\n", p->total, expectedSize);
+    bool hashOk = downloadHashMatches(&p->hash, info.sha256.length() == 64 ? info.sha256 : sha256Hex);
+    
+    bool shown = EPD_7in3E_streamEnd(&p->loader, delivered >= 0 && sizeOk && hashOk);
+    free(p);
+    if (shown) {
+        // 屏幕内容不在任何帧槽中（基准帧与屏幕内容无关，保留）
+        frameTableForget(true, false);
+    }
+    Serial.println(shown ? "========== 下载完成 ==========\n" : "========== 下载失败 ==========\n");
+    return shown;
+}
+#endif
+
+#if EPD_CONDITIONAL_UPDATE
+/**
+ * 单次请求完成更新检查：GET /api/device/<id>/image，带 If-None-Match: "v<本地版本>"
+ * 有新版本时响应体就是云端选好的数据，同一个请求里下载到帧槽
+ * 同时带 X-EPD-Playlist-Max，响应头 X-EPD-Playlist 记在 g_playlistTag（有激活的列表时云端返回 304）
+ * @return 1 = 已下载新版本（g_target* 已设置）；0 = 已是最新（304）；
+ *         -1 = 需要走 status 流程（未绑定/没有图片/旧云端/下载失败）
+ */
+int checkImageConditional() {
+    String url = "http://" + String(CLOUD_API_HOST) + ":" + String(CLOUD_API_PORT) +
+                 "/api/device/" + deviceId + "/image";
+    HttpDownloadInfo info = {};
+    int baseVersion;
+    uint32_t baseCrc;
+    info.formats = acceptedImageFormats(&baseVersion, &baseCrc);
+    if (baseVersion > 0) {
+        info.base = String(baseVersion) + ":" + String(baseCrc);
+    }
+    info.ifNoneMatch = "\"v" + String(localImageVersion) + "\"";
+    info.timing = wakeTimingPending();
+#if EPD_PLAYLIST
+    info.playlistMax = PLAYLIST_MAX_PAGES;
+#endif
+    
+    Serial.printf("📡 条件检查更新（If-None-Match: %s）\n", info.ifNoneMatch.c_str());
+    bool downloaded = downloadImageToFlash(url, 0, "", &info);
+    g_playlistTag = info.playlist;
+    if (info.timing.length() > 0 && (info.httpCode == HTTP_CODE_OK || info.httpCode == HTTP_CODE_NOT_MODIFIED ||
+                                     info.httpCode == HTTP_CODE_NO_CONTENT)) {
+        wakeTimingMarkUploaded();
+    }
+    if (downloaded) {
+        if (info.version <= localImageVersion || info.url.length() == 0) {
+            // 云端响应不完整（理论上不会出现），丢弃并走 status 流程
+            releaseDownloadSlot();
+            return -1;
+        }
+        g_targetImageVersion = info.version;
+        g_targetImageUrl = info.url;
+        g_targetImageFormat = info.format == "delta" ? EPD_FORMAT_DELTA :
+                              (info.format == "rle" ? EPD_FORMAT_RLE :
+                              (info.format == "bin" ? EPD_FORMAT_BIN : EPD_FORMAT_TEXT));
+        g_targetImageSize = info.bytes;
+        g_targetImageSha256 = info.sha256;
+        g_targetImagePrefetched = true;
+        Serial.printf("✅ 已下载新版本 %d（%s）\n", info.version, info.format.c_str());
+        return 1;
+    }
+    if (info.httpCode == HTTP_CODE_NOT_MODIFIED) {
+        Serial.println("✅ 云端返回 304：图片已是最新版本");
+        return 0;
+    }
+    return -1;
+}
+#endif
+
+/**
+ * 差分结果的顺序写入：攒满一个扇区写一次（源数据在映射的 Flash 中，写入前先拷到 RAM）
+ */
+struct DeltaOut {
+    int slot;
+    uint32_t offset;   // 下一批在槽内的偏移
+    uint8_t *buf;      // FRAME_SECTOR_SIZE
+    int fill;
+    bool ok;
+};
+
+static void deltaOutPut(DeltaOut *o, const uint8_t *data, int len) {
+    while (len > 0 && o->ok) {
+        int n = FRAME_SECTOR_SIZE - o->fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(o->buf + o->fill, data, n);
+        o->fill += n;
+        data += n;
+        len -= n;
+        if (o->fill == FRAME_SECTOR_SIZE) {
+            o->ok = frameSlotWrite(o->slot, o->offset, o->buf, o->fill);
+            o->offset += o->fill;
+            o->fill = 0;
+        }
+    }
+}
+
+/**
+ * 把下载的差分帧（槽内 FRAME_DELTA_OFFSET 处）打到基准帧上：先校验差分帧 CRC 和基准帧 CRC，
+ * 再按行合并基准帧和差分行，结果作为 bin 帧写到同一槽的开头（帧头 CRC 为结果帧的 CRC，显示时校验）
+ * 基准帧所在的槽只读不写，显示成功前屏幕对应的帧和基准帧都保持完整
+ * @return 失败时放弃基准帧（不再声明差分支持），调用方应改为下载完整帧
+ */
+bool applyDeltaFrame() {
+    const int rowBytes = (EPD_7IN3E_WIDTH + 1) / 2;
+    bool ok = false;
+    int baseSlot = g_frames.base;
+    esp_partition_mmap_handle_t deltaMap = 0, baseMap = 0;
+    const uint8_t *delta = nullptr, *base = nullptr;
+    DeltaOut out = { g_dlSlot, 0, nullptr, 0, true };
+    EPD_FrameHeader dh, bh;
+    int rangeCount = 0, rowsPatched = 0;
+    
+    do {
+        if (g_dlSlot < 0 || g_dlBase != FRAME_DELTA_OFFSET || baseSlot == FRAME_SLOT_NONE) {
+            Serial.println("❌ 没有差分帧或基准帧");
+            break;
+        }
+        delta = frameSlotMap(g_dlSlot, FRAME_DELTA_OFFSET, g_dlSize, &deltaMap);
+        if (!delta || !EPD_parseFrameHeader(delta, g_dlSize, &dh) ||
+            !EPD_deltaMatchesPanel(&dh, EPD_7IN3E_WIDTH, EPD_7IN3E_HEIGHT) ||
+            g_dlSize != dh.headerLen + (int)dh.payloadLen || dh.payloadLen < EPD_DELTA_PREFIX_SIZE) {
+            Serial.println("❌ 差分帧头无效或与屏幕不符");
+            break;
+        }
+        
+        // 差分帧很小，先整体校验 CRC 再合并
+        const uint8_t *p = delta + dh.headerLen;
+        const uint8_t *end = p + dh.payloadLen;
+        if (esp_rom_crc32_le(0, p, dh.payloadLen) != dh.crc32) {
+            Serial.println("❌ 差分帧CRC校验失败");
+            break;
+        }
+        uint32_t baseCrc = EPD_frameRd32(p);
+        uint32_t targetCrc = EPD_frameRd32(p + 4);
+        rangeCount = EPD_frameRd16(p + 8);
+        p += EPD_DELTA_PREFIX_SIZE;
+        
+        const FrameSlot &bs = g_frames.slot[baseSlot];
+        if (bs.crc != baseCrc) {
+            Serial.println("❌ 基准帧与差分帧不匹配");
+            break;
+        }
+        base = frameSlotMap(baseSlot, 0, bs.size, &baseMap);
+        if (!base || !EPD_parseFrameHeader(base, bs.size, &bh) || bh.pixelFormat != EPD_PIXFMT_BIN4 ||
+            !EPD_frameMatchesPanel(&bh, EPD_7IN3E_WIDTH, EPD_7IN3E_HEIGHT) ||
+            bs.size != bh.headerLen + bh.payloadLen) {
+            Serial.println("❌ 基准帧无效");
+            break;
+        }
+        out.buf = (uint8_t *)malloc(FRAME_SECTOR_SIZE);
+        if (!out.buf) {
+            Serial.println("❌ 内存不足");
+            break;
+        }
+        
+        // 帧头沿用基准帧，CRC 改为结果帧的 CRC
+        uint8_t head[EPD_FRAME_HEADER_SIZE];
+        memcpy(head, base, EPD_FRAME_HEADER_SIZE);
+        head[16] = (uint8_t)targetCrc;
+        head[17] = (uint8_t)(targetCrc >> 8);
+        head[18] = (uint8_t)(targetCrc >> 16);
+        head[19] = (uint8_t)(targetCrc >> 24);
+        deltaOutPut(&out, head, EPD_FRAME_HEADER_SIZE);
+        deltaOutPut(&out, base + EPD_FRAME_HEADER_SIZE, bh.headerLen - EPD_FRAME_HEADER_SIZE);
+        
+        // 行范围按行号升序：范围之间的行取自基准帧，范围内的行取自差分帧
+        const uint8_t *baseRows = base + bh.headerLen;
+        int row = 0;
+        bool rangesOk = true;
+        for (int r = 0; r < rangeCount && rangesOk; r++) {
+            if (end - p < EPD_DELTA_RANGE_SIZE) {
+                rangesOk = false;
+                break;
+            }
+            int rowStart = EPD_frameRd16(p);
+            int rowCount = EPD_frameRd16(p + 2);
+            p += EPD_DELTA_RANGE_SIZE;
+            if (rowStart < row || rowStart + rowCount > EPD_7IN3E_HEIGHT || end - p < rowCount * rowBytes) {
+                rangesOk = false;
+                break;
+            }
+            deltaOutPut(&out, baseRows + row * rowBytes, (rowStart - row) * rowBytes);
+            deltaOutPut(&out, p, rowCount * rowBytes);
+            p += rowCount * rowBytes;
+            row = rowStart + rowCount;
+            rowsPatched += rowCount;
+        }
+        if (!rangesOk) {
+            Serial.println("❌ 差分数据损坏");
+            break;
+        }
+        deltaOutPut(&out, baseRows + row * rowBytes, (EPD_7IN3E_HEIGHT - row) * rowBytes);
+        if (out.ok && out.fill > 0) {
+            out.ok = frameSlotWrite(out.slot, out.offset, out.buf, out.fill);
+            out.offset += out.fill;
+        }
+        if (!out.ok) {
+            Serial.println("❌ 写入帧分区失败");
+            break;
+        }
+        Serial.printf("✅ 差分更新: %d 段共 %d 行（差分帧 %d 字节）\n", rangeCount, rowsPatched, g_dlSize);
+        ok = true;
+    } while (0);
+    
+    if (delta) {
+        frameSlotUnmap(deltaMap);
+    }
+    if (base) {
+        frameSlotUnmap(baseMap);
+    }
+    free(out.buf);
+    
+    if (!ok) {
+        releaseDownloadSlot();
+        frameTableForget(false, true);
+        return false;
+    }
+    // 结果按普通 bin 帧显示
+    g_dlBase = 0;
+    g_dlSize = (int)out.offset;
+    return true;
+}
+
+/**
+ * 按槽内数据的帧头填写槽表记录的格式和 CRC（文本帧为 TEXT/0）
+ */
+static void frameSlotDescribe(int slot, int size, FrameSlot *meta) {
+    meta->size = size;
+    meta->format = EPD_FORMAT_TEXT;
+    meta->crc = 0;
+    uint8_t head[EPD_FRAME_HEADER_SIZE];
+    EPD_FrameHeader header;
+    if (size >= EPD_FRAME_HEADER_SIZE && frameSlotRead(slot, 0, head, sizeof(head)) &&
+        EPD_isFrame(head, sizeof(head)) && EPD_parseFrameHeader(head, sizeof(head), &header)) {
+        meta->format = header.pixelFormat == EPD_PIXFMT_RLE4 ? EPD_FORMAT_RLE : EPD_FORMAT_BIN;
+        meta->crc = header.crc32;
+    }
+}
+
+/**
+ * 映射帧槽并解码刷新EPD（下载的新帧、离线重显和播放列表共用）
+ * 刷新前在映射区上计算整块数据的 SHA-256，作为槽内容的标识
+ * @param expectSha256 非空时先与它核对（离线重显），不一致则不刷新
+ * @param sha256 输出：数据的 SHA-256
+ * @return 是否发出了刷新（数据异常/校验失败时不刷新，屏幕保持原画面）
+ */
+static bool showFrameSlot(int slot, int size, const uint8_t *expectSha256, uint8_t *sha256) {
+    esp_partition_mmap_handle_t map;
+    const uint8_t *data = frameSlotMap(slot, 0, size, &map);
+    if (!data) {
+        Serial.println("❌ 帧槽映射失败");
+        return false;
+    }
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, data, size);
+    mbedtls_sha256_finish(&ctx, sha256);
+    mbedtls_sha256_free(&ctx);
+    if (expectSha256 && memcmp(sha256, expectSha256, 32) != 0) {
+        Serial.printf("❌ 槽 %d 的数据与记录的 SHA-256 不符，跳过刷新\n", slot);
+        frameSlotUnmap(map);
+        return false;
+    }
+    
+    // 初始化EPD
+    if (EPD_dispIndex < 0 || EPD_dispIndex >= (sizeof(EPD_dispMass) / sizeof(EPD_dispMass[0]))) {
+        EPD_dispIndex = 0;
+    }
+    uint8_t prevPhase = wakeTimingSwitch(WAKE_PHASE_DECODE);
+    EPD_dispInit();
+    
+    // 调用显示函数（直接读映射的帧槽）
+    EPD_7in3E_frameData = data;
+    EPD_7in3E_frameSize = size;
+    EPD_7in3E_frameShown = false;
+    if (EPD_dispLoad != nullptr) {
+        EPD_dispLoad();
+        Serial.println(EPD_7in3E_frameShown ? "✅ 图片显示完成" : "❌ 图片未显示");
+    } else {
+        Serial.println("❌ EPD_dispLoad未设置");
+    }
+    EPD_7in3E_frameData = nullptr;
+    EPD_7in3E_frameSize = 0;
+    frameSlotUnmap(map);
+    wakeTimingSwitch(prevPhase);
+    return EPD_7in3E_frameShown;
+}
+
+/**
+ * 显示下载的图片（映射帧槽后解码刷新EPD）
+ * 刷新发出后该槽成为当前帧（记下版本号和 SHA-256，之后可离线重显）；CRC 校验通过的 bin 帧
+ * 同时成为差分基准帧，否则基准帧不变：它只是云端历史中某个版本的数据，与屏幕当前内容无关
+ * @param version 图片版本号
+ * @return 是否发出了刷新（数据异常/校验失败时不刷新，屏幕保持原画面）
+ */
+bool displayDownloadedImage(int version = 0) {
+    Serial.println("📺 开始显示图片...");
+    
+    int slot = g_dlSlot;
+    int size = g_dlSize;
+    releaseDownloadSlot();
+    if (slot < 0 || size <= 0) {
+        Serial.println("❌ 没有下载好的图片");
         return false;
     }
-    flashTempFileOpen = true;
-    flashTempFileSize = 0;
-    
-    HTTPClient http;
-    if (!http.begin(imageUrl)) {
-        Serial.println("❌ HTTP begin失败");
-        flashTempFile.close();
-        flashTempFileOpen = false;
+
+    // 设备端最小防护：显示前再做一次长度检查，避免 EPD 驱动因数据异常 busy 卡死
+    int expected = frameExpectedSize(slot, 0, size);
+    if (size != expected) {
+        Serial.printf("❌ 帧数据大小异常：期望 %d，实际 %d；跳过刷新\n", expected, size);
         return false;
     }
+    FrameSlot meta = {};
+    meta.version = version;
+    frameSlotDescribe(slot, size, &meta);
     
-    http.setTimeout(CLOUD_DOWNLOAD_TIMEOUT_MS);
-    http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    
-    int httpCode = http.GET();
-    Serial.printf("   HTTP状态码: %d\n", httpCode);
-    
-    if (httpCode != HTTP_CODE_OK) {
-        Serial.printf("❌ HTTP下载失败: %d\n", httpCode);
-        http.end();
-        flashTempFile.close();
-        flashTempFileOpen = false;
-        SPIFFS.remove(FLASH_TEMP_FILE);
+    if (!showFrameSlot(slot, size, nullptr, meta.sha256)) {
         return false;
     }
-    
-    int contentLength = http.getSize();
-    Serial.printf("   内容长度: %d 字节 (%.2f KB)\n", contentLength, contentLength / 1024.0);
+    bool asBase = false;
+#if EPD_ACCEPT_DELTA_FRAME
+    asBase = EPD_7in3E_frameVerified && meta.format == EPD_FORMAT_BIN && version > 0;
+#endif
+    if (!frameSlotCommit(slot, meta, asBase, !EPD_7in3E_refreshInFlight)) {
+        // 画面已经发出，但冷启动后 NVS 中仍是旧表：调用方看 g_frames.dirty，不提交版本号
+        Serial.println("⚠️  帧槽表未写入NVS，本次显示的帧不作为持久的当前帧");
+    } else if (asBase) {
+        Serial.printf("💾 已保存基准帧: 版本 %d（槽 %d），下次可差分更新\n", version, slot);
+    }
+    return true;
+}
 
-    // 设备端最小防护：如果云端返回了 Content-Length，但不是期望长度，直接判失败
-    // 这样可以避免把“坏/半截数据”交给 EPD 驱动，导致 busy 卡死
-    if (contentLength > 0 && contentLength != EPD_EXPECTED_CHARS) {
-        Serial.printf("❌ 内容长度异常，期望 %d，实际 %d，放弃下载\n", EPD_EXPECTED_CHARS, contentLength);
-        http.end();
-        flashTempFile.close();
-        flashTempFileOpen = false;
-        SPIFFS.remove(FLASH_TEMP_FILE);
-        flashTempFileSize = 0;
+/**
+ * 不联网重显当前帧（最近一次显示成功的帧）：槽的版本须等于本地图片版本（或是播放列表的页），
+ * 数据须与记录的 SHA-256 一致
+ * 用于屏幕画面被设备码覆盖、刷新被复位/掉电打断，或按键要求重显
+ * @return 是否发出了刷新；没有可用的当前帧时返回 false（调用方照常联网更新）
+ */
+bool redisplayCurrentFrame() {
+    Serial.println("📺 从帧分区重显当前帧（不联网）...");
+    if (!frameStoreInit() || g_frames.current == FRAME_SLOT_NONE) {
+        Serial.println("ℹ️  没有保存的当前帧");
         return false;
     }
-    
-    // 流式下载，分块写入SPIFFS
-    WiFiClient *stream = http.getStreamPtr();
-    uint8_t buffer[512];  // 512字节缓冲区
-    int totalRead = 0;
-    unsigned long startTime = millis();
-    int noDataCount = 0;
-    const int MAX_NO_DATA_COUNT = 100;
-    
-    while (http.connected() && (contentLength > 0 || contentLength == -1)) {
-        if (millis() - startTime > CLOUD_DOWNLOAD_TIMEOUT_MS) {
-            Serial.println("❌ 下载超时！");
-            break;
-        }
-        
-        size_t available = stream->available();
-        if (available) {
-            noDataCount = 0;
-            int bytesToRead = (available > sizeof(buffer)) ? sizeof(buffer) : available;
-            int bytesRead = stream->readBytes(buffer, bytesToRead);
-
-            if (bytesRead <= 0) {
-                noDataCount++;
-                delay(10);
-                continue;
-            }
-            
-            // 直接写入Flash
-            flashTempFile.write(buffer, bytesRead);
-            flashTempFileSize += bytesRead;
-            totalRead += bytesRead;
-            
-            if (contentLength > 0) {
-                contentLength -= bytesRead;
-            }
-            
-            // 每64KB输出一次进度
-            if (totalRead % 65536 == 0) {
-                Serial.printf("   已下载: %.2f KB\n", totalRead / 1024.0);
-            }
-
-            // 如果 contentLength 未知（-1），但我们已经达到期望长度，也直接结束（防止超读）
-            if (contentLength == -1 && totalRead >= EPD_EXPECTED_CHARS) {
-                break;
-            }
-        } else {
-            noDataCount++;
-            if (noDataCount > MAX_NO_DATA_COUNT) {
-                break;
-            }
-            delay(10);
-        }
+    int slot = g_frames.current;
+    const FrameSlot &meta = g_frames.slot[slot];
+    if (meta.version != g_devState.imageVersion && !frameSlotInPlaylist(slot)) {
+        Serial.printf("ℹ️  当前帧版本 %d 与本地图片版本 %d 不符，不重显\n",
+                      (int)meta.version, (int)g_devState.imageVersion);
+        return false;
     }
-    
-    flashTempFile.flush();
-    flashTempFile.close();
-    flashTempFileOpen = false;
-    
-    http.end();
-    
-    // 检查下载结果
-    Serial.printf("✅ 下载完成: %d 字符 (%.2f KB)\n", flashTempFileSize, flashTempFileSize / 1024.0);
-    Serial.printf("   期望大小: %d 字符\n", EPD_EXPECTED_CHARS);
-
-    // 设备端最小防护：只要不是“完全匹配”，就视为失败并删除临时文件
-    if (flashTempFileSize != EPD_EXPECTED_CHARS) {
-        Serial.printf("❌ 下载不完整：期望 %d，实际 %d，删除临时文件并放弃本次刷新\n",
-                      EPD_EXPECTED_CHARS, flashTempFileSize);
-        SPIFFS.remove(FLASH_TEMP_FILE);
-        flashTempFileSize = 0;
-        Serial.println("========== 下载失败 ==========\n");
+    uint8_t sha256[32];
+    if (!showFrameSlot(slot, meta.size, meta.sha256, sha256)) {
+        // 数据已损坏：不再当作当前帧，下次联网时重新下载
+        frameTableForget(true, false);
         return false;
     }
-    
-    Serial.println("========== 下载完成 ==========\n");
+    if (!EPD_7in3E_refreshInFlight) {
+        frameTableSetStale(false);
+    }
+    Serial.printf("✅ 已重显版本 %d（槽 %d）\n", (int)meta.version, slot);
     return true;
 }
 
+#if EPD_PLAYLIST
+/* ============================================================================
+ *                            播放列表（激活的页面列表）
+ * ============================================================================ */
+
 /**
- * 显示下载的图片（从Flash读取并刷新EPD）
+ * 退出播放列表模式：各页的槽不再保留；屏幕上是列表的页时清零本地图片版本，
+ * 接下来的条件 GET 会重新下载当前的单张图片
  */
-void displayDownloadedImage() {
-    Serial.println("📺 开始显示图片...");
-    
-    if (!SPIFFS.exists(FLASH_TEMP_FILE)) {
-        Serial.println("❌ 临时文件不存在");
+static void playlistClear() {
+    if (g_playlist.count == 0 && g_playlist.listId == 0) {
         return;
     }
+    Serial.println("📋 云端没有激活的页面列表，退出播放列表模式");
+    bool showingPage = g_frames.current != FRAME_SLOT_NONE && frameSlotInPlaylist(g_frames.current);
+    memset(&g_playlist, 0, sizeof(g_playlist));
+    g_playlistCursor.index = 0;
+    if (showingPage) {
+        g_frames.current = FRAME_SLOT_NONE;
+        g_frames.stale = 0;
+        saveImageVersion(0);
+        localImageVersion = 0;
+    }
+    frameTableDropUnpinned();
+    frameTableSave();
+}
 
-    // 设备端最小防护：显示前再做一次长度检查，避免 EPD 驱动因数据异常 busy 卡死
-    {
-        File f = SPIFFS.open(FLASH_TEMP_FILE, "r");
-        if (!f) {
-            Serial.println("❌ 无法打开临时文件");
-            SPIFFS.remove(FLASH_TEMP_FILE);
-            return;
+/**
+ * 从列表中去掉第 index 页（数据损坏），并让下次联网时重新获取清单
+ */
+static void playlistDropPage(int index) {
+    memset(&g_frames.slot[g_playlist.slot[index]], 0, sizeof(FrameSlot));
+    for (int i = index; i + 1 < g_playlist.count; i++) {
+        g_playlist.slot[i] = g_playlist.slot[i + 1];
+    }
+    g_playlist.count--;
+    g_playlist.listId = 0;
+    frameTableSave();
+}
+
+/**
+ * 按新清单更新播放列表：SHA-256 与已有槽一致的页直接复用，其余下载到空闲槽
+ * 下载时列表中已确定的页都被保留，不会被选作写入槽；下载失败的页先跳过，listId 记为 0，
+ * 下次唤醒重新获取清单补齐
+ * @return 列表中可以显示的页数
+ */
+static int playlistSync(const uint8_t *manifest, const EPD_Playlist& pl) {
+    if (!frameStoreInit()) {
+        return 0;
+    }
+    bool changed = pl.listId != g_playlist.listId;
+    int count = pl.count < PLAYLIST_MAX_PAGES ? pl.count : PLAYLIST_MAX_PAGES;
+    PlaylistTable next = {};
+    next.listId = pl.listId;
+    next.intervalMin = pl.intervalMin;
+    next.count = count;
+    for (int i = 0; i < count; i++) {
+        EPD_PlaylistEntry e;
+        EPD_playlistEntry(manifest, i, &e);
+        next.slot[i] = FRAME_SLOT_NONE;
+        for (int j = 0; j < g_frameSlotCount; j++) {
+            if (g_frames.slot[j].version != 0 && g_frames.slot[j].size == e.size &&
+                memcmp(g_frames.slot[j].sha256, e.sha256, 32) == 0) {
+                next.slot[i] = j;
+                break;
+            }
         }
-        size_t sz = f.size();
-        f.close();
-        if ((int)sz != EPD_EXPECTED_CHARS) {
-            Serial.printf("❌ 临时文件大小异常：期望 %d，实际 %d；跳过刷新并删除临时文件\n",
-                          EPD_EXPECTED_CHARS, (int)sz);
-            SPIFFS.remove(FLASH_TEMP_FILE);
-            return;
+    }
+    // 先换成新列表：复用的槽从这里开始受保护，旧列表中不再需要的槽成为空闲槽
+    g_playlist = next;
+
+    for (int i = 0; i < count; i++) {
+        if (g_playlist.slot[i] != FRAME_SLOT_NONE) {
+            continue;
+        }
+        EPD_PlaylistEntry e;
+        EPD_playlistEntry(manifest, i, &e);
+        char url[EPD_PLAYLIST_MAX_URL + 1];
+        char sha256Hex[65];
+        memcpy(url, e.url, e.urlLen);
+        url[e.urlLen] = '\0';
+        for (int k = 0; k < 32; k++) {
+            sprintf(sha256Hex + 2 * k, "%02x", e.sha256[k]);
         }
+        Serial.printf("📋 预取第 %d/%d 页（%u 字节）\n", i + 1, count, (unsigned)e.size);
+        if (!downloadImageToFlash(url, e.size, sha256Hex)) {
+            g_playlist.listId = 0;
+            continue;
+        }
+        FrameSlot meta = {};
+        meta.version = PLAYLIST_FRAME_VERSION;
+        frameSlotDescribe(g_dlSlot, g_dlSize, &meta);
+        memcpy(meta.sha256, e.sha256, 32);
+        g_frames.slot[g_dlSlot] = meta;
+        g_playlist.slot[i] = g_dlSlot;
+        releaseDownloadSlot();
     }
-    
-    // 初始化EPD
-    if (EPD_dispIndex < 0 || EPD_dispIndex >= (sizeof(EPD_dispMass) / sizeof(EPD_dispMass[0]))) {
-        EPD_dispIndex = 0;
+
+    // 去掉没有下载成功的页
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (g_playlist.slot[i] != FRAME_SLOT_NONE) {
+            g_playlist.slot[n++] = g_playlist.slot[i];
+        }
+    }
+    g_playlist.count = n;
+    if (n == 0) {
+        g_playlist.listId = 0;
+    }
+    if (changed) {
+        // 新列表从第一页开始（下一次显示 index + 1）
+        g_playlistCursor.index = n > 0 ? n - 1 : 0;
+    }
+    frameTableDropUnpinned();
+    if (!frameTableSave()) {
+        // NVS 中仍是旧列表：下次联网时重新获取清单并再写一次
+        g_playlist.listId = 0;
+    }
+    Serial.printf("✅ 播放列表: %d 页，每页 %d 分钟（槽", n, (int)g_playlist.intervalMin);
+    for (int i = 0; i < n; i++) {
+        Serial.printf(" %d", g_playlist.slot[i]);
+    }
+    Serial.println("）");
+    return n;
+}
+
+/**
+ * 检查激活的页面列表：GET /api/device/<id>/playlist，带 If-None-Match: "l<listId>"
+ * 清单有变化时把缺少的页预取到帧分区（见 playlistSync）
+ * @return 1 = 有播放列表；0 = 没有激活的列表（已退出播放列表模式，按单张图片工作）；-1 = 请求失败
+ */
+static int fetchPlaylist() {
+    String url = CLOUD_API_BASE "/api/device/" + deviceId + "/playlist";
+    HTTPClient http;
+    if (!cloudHttpBegin(http, url)) {
+        Serial.println("❌ HTTP begin失败");
+        return -1;
+    }
+    http.setTimeout(CLOUD_API_TIMEOUT_MS);
+    int baseVersion;
+    uint32_t baseCrc;
+    http.addHeader("X-EPD-Formats", acceptedImageFormats(&baseVersion, &baseCrc));
+    http.addHeader("X-EPD-Playlist-Max", String(PLAYLIST_MAX_PAGES));
+    if (g_playlist.listId != 0) {
+        http.addHeader("If-None-Match", "\"l" + String(g_playlist.listId) + "\"");
+    }
+    String timing = wakeTimingPending();
+    if (timing.length() > 0) {
+        http.addHeader("X-EPD-Timing", timing);
     }
-    EPD_dispInit();
     
-    // 调用显示函数（从Flash读取）
-    if (EPD_dispLoad != nullptr) {
-        EPD_dispLoad();
-        Serial.println("✅ 图片显示完成");
-    } else {
-        Serial.println("❌ EPD_dispLoad未设置");
+    Serial.printf("📡 检查播放列表（本地清单 %lu）\n", (unsigned long)g_playlist.listId);
+    int httpCode = cloudHttpSend(http, "GET");
+    if (timing.length() > 0 && (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_NOT_MODIFIED ||
+                                httpCode == HTTP_CODE_NO_CONTENT)) {
+        wakeTimingMarkUploaded();
+    }
+    if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+        cloudHttpEnd(http, true);
+        Serial.println("✅ 播放列表未变化");
+        g_playlistCursor.sinceCheckMin = 0;
+        return g_playlist.count > 0 ? 1 : 0;
+    }
+    if (httpCode == HTTP_CODE_NO_CONTENT || httpCode == HTTP_CODE_NOT_FOUND) {
+        // 404：旧云端没有播放列表接口
+        cloudHttpEnd(http, httpCode == HTTP_CODE_NO_CONTENT);
+        playlistClear();
+        return 0;
+    }
+    if (httpCode != HTTP_CODE_OK) {
+        Serial.printf("❌ HTTP错误: %d\n", httpCode);
+        cloudHttpEnd(http, false);
+        return -1;
     }
     
-    // 清除临时文件
-    clearFlashTempFile();
+    uint8_t manifest[EPD_PLAYLIST_MAX_RESP(PLAYLIST_MAX_PAGES)];
+    int len = http.getSize();
+    int got = 0;
+    if (len >= EPD_PLAYLIST_HEADER && len <= (int)sizeof(manifest)) {
+        got = http.getStreamPtr()->readBytes(manifest, len);
+    }
+    EPD_Playlist pl;
+    bool parsed = got == len && EPD_playlistParse(manifest, len, &pl);
+    cloudHttpEnd(http, got == len);
+    if (!parsed) {
+        Serial.printf("❌ 播放列表清单无效（长度 %d，收到 %d）\n", len, got);
+        return -1;
+    }
+    g_playlistCursor.sinceCheckMin = 0;
+    return playlistSync(manifest, pl) > 0 ? 1 : -1;
+}
+
+/**
+ * 联网唤醒时更新播放列表：按条件 GET 告知的激活列表（g_playlistTag），与本地清单不同时才取清单，
+ * 没有激活的列表时退出播放列表模式；云端没有告知（旧云端、请求失败、没做条件 GET）时
+ * 只在已有播放列表或没做条件 GET 时取清单，没有列表的设备不多发请求
+ * @return 是否按播放列表显示（有可显示的页；请求失败时沿用已有的列表）
+ */
+static bool playlistRefresh(bool conditionalTried) {
+    int playlist = 0;
+    if (g_playlistTag == "none") {
+        playlistClear();
+    } else if (g_playlistTag.length() > 0) {
+        if (g_playlist.count > 0 && g_playlistTag == "\"l" + String(g_playlist.listId) + "\"") {
+            Serial.println("✅ 播放列表未变化");
+            g_playlistCursor.sinceCheckMin = 0;
+            playlist = 1;
+        } else {
+            playlist = fetchPlaylist();
+        }
+    } else if (g_playlist.count > 0 || !conditionalTried) {
+        playlist = fetchPlaylist();
+    }
+    return playlist > 0 || (playlist < 0 && g_playlist.count > 0);
+}
+
+/**
+ * 显示播放列表的下一页（从帧分区读取，不联网）
+ * 数据与记录的 SHA-256 不符时去掉该页（下次联网重新获取清单），接着试下一页
+ * @return 是否发出了刷新
+ */
+static bool playlistShowNext() {
+    if (!frameStoreInit()) {
+        return false;
+    }
+    while (g_playlist.count > 0) {
+        int index = (g_playlistCursor.index + 1) % g_playlist.count;
+        int slot = g_playlist.slot[index];
+        FrameSlot meta = g_frames.slot[slot];
+        uint8_t sha256[32];
+        Serial.printf("📺 播放列表第 %d/%d 页（槽 %d）\n", index + 1, (int)g_playlist.count, slot);
+        if (showFrameSlot(slot, meta.size, meta.sha256, sha256)) {
+            g_playlistCursor.index = index;
+            frameSlotFlipPage(slot, meta, !EPD_7in3E_refreshInFlight);
+            return true;
+        }
+        playlistDropPage(index);
+        // 后面的页前移到 index，下一轮从它开始
+        g_playlistCursor.index = index > 0 ? index - 1 : (g_playlist.count > 0 ? g_playlist.count - 1 : 0);
+    }
+    return false;
+}
+
+/**
+ * 清单是否需要联网检查：定时唤醒累计满 PLAYLIST_CHECK_MINUTES，或上次预取不完整
+ */
+static inline bool playlistCheckDue() {
+    return g_playlist.listId == 0 || g_playlistCursor.sinceCheckMin >= PLAYLIST_CHECK_MINUTES;
 }
+#endif
 
 /* ============================================================================
  *                            Deep-sleep 管理
@@ -637,23 +2083,42 @@ void printWakeupReason() {
     Serial.println("========================================\n");
 }
 
+/**
+ * 定时唤醒间隔：播放列表模式下为每页显示时长，否则为 DEEP_SLEEP_INTERVAL_HOURS
+ */
+static uint64_t deepSleepIntervalUs() {
+#if EPD_PLAYLIST
+    if (g_devState.claimed && g_playlist.count > 0) {
+        return g_playlist.intervalMin * 60ULL * 1000000ULL;
+    }
+#endif
+    return DEEP_SLEEP_INTERVAL_US;
+}
+
 /**
  * 配置Deep-sleep唤醒源并进入睡眠
  */
 void enterDeepSleep() {
     // 幂等：如果已经开始准备进入 deep-sleep，避免重复执行关 WiFi/配置唤醒源等耗时动作
     if (g_deepSleepRequested) {
+        wakeTimingCommit(esp_sleep_get_wakeup_cause());
+        deviceStateSeal();
         Serial.flush();
         delay(50);
         esp_deep_sleep_start();
         return;
     }
     g_deepSleepRequested = true;
+    wakeTimingSwitch(WAKE_PHASE_SLEEP_PREP);
 
     Serial.println("\n========================================");
     Serial.println("💤 准备进入Deep-sleep...");
     Serial.println("========================================");
     
+    // 0. 关闭复用的云端连接，并汇报本次唤醒建立的连接数（理想情况为 1）
+    g_cloudClient.stop();
+    Serial.printf("   本次唤醒建立 HTTP 连接 %d 次\n", g_cloudConnections);
+    
     // 1. 关闭WiFi
     Serial.println("   关闭WiFi...");
     WiFi.disconnect(true);
@@ -685,15 +2150,18 @@ void enterDeepSleep() {
     Serial.println("   配置GPIO0按键唤醒...");
     esp_deep_sleep_enable_gpio_wakeup(1ULL << WAKEUP_GPIO, ESP_GPIO_WAKEUP_GPIO_LOW);
     
-    // 3. 配置定时唤醒（12小时）
-    Serial.printf("   配置定时唤醒: %d 小时\n", DEEP_SLEEP_INTERVAL_HOURS);
-    esp_sleep_enable_timer_wakeup(DEEP_SLEEP_INTERVAL_US);
+    // 3. 配置定时唤醒（12小时；播放列表模式下为每页显示时长）
+    uint64_t intervalUs = deepSleepIntervalUs();
+    Serial.printf("   配置定时唤醒: %lu 分钟\n", (unsigned long)(intervalUs / 60000000ULL));
+    esp_sleep_enable_timer_wakeup(intervalUs);
     
     // 4. 打印信息
     Serial.println("\n✅ Deep-sleep配置完成:");
     Serial.println("   - GPIO0 按键唤醒（低电平）");
-    Serial.printf("   - 定时唤醒: %d 小时后\n", DEEP_SLEEP_INTERVAL_HOURS);
+    Serial.printf("   - 定时唤醒: %lu 分钟后\n", (unsigned long)(intervalUs / 60000000ULL));
     Serial.println("   - 墨水屏将保持当前画面");
+    wakeTimingCommit(esp_sleep_get_wakeup_cause());
+    deviceStateSeal();  // 之后不再修改 RTC 状态
     Serial.println("\n💤 进入Deep-sleep...\n");
     Serial.flush();
     delay(100);
@@ -704,18 +2172,203 @@ void enterDeepSleep() {
     // 不会执行到这里
 }
 
+/**
+ * 保持/释放墨水屏控制引脚的电平
+ * 深睡期间数字 GPIO 默认不保持输出，RST 被拉低会打断正在进行的刷新
+ */
+static void holdPanelPins(bool hold) {
+    const gpio_num_t pins[] = { (gpio_num_t)EPD_RST_PIN, (gpio_num_t)EPD_CS_PIN, (gpio_num_t)EPD_DC_PIN };
+    for (size_t i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+        if (hold) {
+            gpio_hold_en(pins[i]);
+        } else {
+            gpio_hold_dis(pins[i]);
+        }
+    }
+    if (hold) {
+        gpio_deep_sleep_hold_en();
+    } else {
+        gpio_deep_sleep_hold_dis();
+    }
+}
+
+/**
+ * 刷新进行中进入Deep-sleep：记录待完成工作，定时唤醒后检查 BUSY
+ * 只配置定时唤醒，刷新完成前不响应按键
+ */
+void enterRefreshDeepSleep(int version, uint32_t sleepMs) {
+    // 上次没提交成功的版本号（settled）被这次刷新取代
+    if (g_pendingRefresh.magic != EPD_REFRESH_PENDING_MAGIC || g_pendingRefresh.settled) {
+        g_pendingRefresh.magic = EPD_REFRESH_PENDING_MAGIC;
+        g_pendingRefresh.version = version;
+        g_pendingRefresh.polls = 0;
+        g_pendingRefresh.settled = 0;
+    }
+
+    Serial.printf("💤 刷新进行中，Deep-sleep %lu ms 后检查BUSY（待提交版本: %d）\n",
+                  (unsigned long)sleepMs, (int)g_pendingRefresh.version);
+    wakeTimingSwitch(WAKE_PHASE_SLEEP_PREP);
+
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+    esp_wifi_stop();
+
+    holdPanelPins(true);
+    esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+    wakeTimingCommit(esp_sleep_get_wakeup_cause());
+    deviceStateSeal();
+    Serial.flush();
+    esp_deep_sleep_start();
+}
+
+/**
+ * 提交刷新完成后的版本号：帧槽表和版本号都写入 NVS 后才清除待完成工作，
+ * 任何一项失败都保留（settled），版本号不前进，下次唤醒重试
+ * @return 是否已提交
+ */
+static bool commitPendingRefresh() {
+    g_pendingRefresh.settled = 1;
+    if (!frameTableSetStale(false)) {
+        Serial.println("⚠️  帧槽表未写入NVS，本次不提交版本号");
+        return false;
+    }
+    if (!saveImageVersion(g_pendingRefresh.version)) {
+        return false;
+    }
+    localImageVersion = g_pendingRefresh.version;
+    g_pendingRefresh.magic = 0;
+    return true;
+}
+
+/**
+ * 唤醒后处理上次刷新留下的待完成工作（在 setup 中、联网之前调用）
+ * - 无待完成工作：返回 false，继续正常流程
+ * - 上次刷新已完成、只差写入 NVS：重试提交，返回 false，继续正常流程
+ * - 屏幕仍在刷新：再次深睡
+ * - 刷新完成：屏幕断电睡眠、提交版本号，然后正常进入Deep-sleep
+ * - 等待超时：屏幕断电睡眠，不提交版本号（当前帧保持 stale），然后正常进入Deep-sleep
+ */
+bool HTTP_UPDATE__resumePendingRefresh() {
+    if (g_pendingRefresh.magic != EPD_REFRESH_PENDING_MAGIC) {
+        return false;
+    }
+    if (g_pendingRefresh.settled) {
+        Serial.printf("💾 重试提交版本号 %d\n", (int)g_pendingRefresh.version);
+        commitPendingRefresh();
+        return false;
+    }
+    wakeTimingSwitch(WAKE_PHASE_REFRESH);
+
+    // 引脚仍处于保持状态：先把输出寄存器设成与保持值一致，再释放保持，避免RST产生毛刺
+    digitalWrite(EPD_RST_PIN, HIGH);
+    digitalWrite(EPD_CS_PIN, HIGH);
+    holdPanelPins(false);
+
+    if (DEV_Digital_Read(EPD_BUSY_PIN) == 0) {
+        if (g_pendingRefresh.polls < EPD_REFRESH_MAX_POLLS) {
+            g_pendingRefresh.polls++;
+            enterRefreshDeepSleep(g_pendingRefresh.version, EPD_REFRESH_POLL_WAKE_MS);
+            return true;  // 不会执行到这里
+        }
+        // 画面未确认刷新完成：与加载时等待BUSY超时一样按显示失败处理，下次联网重新下载
+        Serial.println("⚠️  等待刷新完成超时，直接断电收尾，不提交版本号");
+        EPD_7IN3E_Sleep();
+        g_pendingRefresh.magic = 0;
+        enterDeepSleep();
+        return true;
+    }
+
+    Serial.printf("✅ 刷新已完成（追加唤醒 %d 次），屏幕进入睡眠\n", (int)g_pendingRefresh.polls);
+    EPD_7IN3E_Sleep();
+    commitPendingRefresh();
+
+    enterDeepSleep();
+    return true;
+}
+
+/**
+ * 启动时屏幕是否需要重显当前帧：设备码覆盖过画面，或上次刷新未确认完成就被复位/掉电（stale）
+ * 欠压复位时不重显：电池可能撑不住刷新的大电流，立即重显会反复 欠压→刷新→欠压 直到耗尽；
+ * stale 保留，到下次正常唤醒联网后再重显
+ */
+bool HTTP_UPDATE__panelNeedsRedisplay() {
+    if (g_devState.claimed == 0 || g_frames.current == FRAME_SLOT_NONE) {
+        return false;
+    }
+    if (esp_reset_reason() == ESP_RST_BROWNOUT) {
+        Serial.println("⚠️  欠压复位：本次不重显，直接回睡");
+        return false;
+    }
+    return g_frames.stale;
+}
+
+/**
+ * 不联网重显当前帧后进入Deep-sleep（在 setup 中、联网之前调用）
+ * @return 没有可重显的帧时返回 false，调用方继续正常流程；否则不返回
+ */
+bool HTTP_UPDATE__redisplayOffline() {
+#if EPD_REFRESH_DEEP_SLEEP
+    EPD_7in3E_deferRefreshWait = true;
+#endif
+    localImageVersion = g_devState.imageVersion;
+    if (!redisplayCurrentFrame()) {
+        return false;
+    }
+    if (EPD_7in3E_refreshInFlight) {
+        enterRefreshDeepSleep(localImageVersion, EPD_REFRESH_FIRST_WAKE_MS);
+    }
+    enterDeepSleep();
+    return true;
+}
+
+/**
+ * 播放列表的离线翻页（在 setup 中、联网之前调用）：定时唤醒和短按GPIO0时显示下一页后直接回睡
+ * @return 没有播放列表、清单需要联网检查或没有可显示的页时返回 false，调用方照常联网；否则不返回
+ */
+bool HTTP_UPDATE__playlistRotateOffline(esp_sleep_wakeup_cause_t cause) {
+#if EPD_PLAYLIST
+    if (g_devState.claimed == 0 || g_playlist.count == 0) {
+        return false;
+    }
+    if (cause == ESP_SLEEP_WAKEUP_TIMER) {
+        g_playlistCursor.sinceCheckMin += g_playlist.intervalMin;
+    } else if (cause != ESP_SLEEP_WAKEUP_GPIO) {
+        return false;
+    }
+    if (playlistCheckDue()) {
+        Serial.println("📋 播放列表清单到期，联网检查");
+        return false;
+    }
+#if EPD_REFRESH_DEEP_SLEEP
+    EPD_7in3E_deferRefreshWait = true;
+#endif
+    localImageVersion = g_devState.imageVersion;
+    if (!playlistShowNext()) {
+        return false;
+    }
+    if (EPD_7in3E_refreshInFlight) {
+        enterRefreshDeepSleep(localImageVersion, EPD_REFRESH_FIRST_WAKE_MS);
+    }
+    enterDeepSleep();
+    return true;
+#else
+    return false;
+#endif
+}
+
 /* ============================================================================
  *                            主要更新流程（一次性判定 + 条件执行）
  * ============================================================================ */
 
 /**
- * 本次唤醒：执行一次性“是否需要更新”的判定（不在这里下载/刷新）
- * - 只做 status 查询与版本比较
+ * 本次唤醒：执行一次性“是否需要更新”的判定（不在这里刷新）
+ * - 条件 GET 与版本比较；条件 GET 返回新图片时已在这里下载到Flash（g_targetImagePrefetched）
+ * - 条件 GET 没有结果时再做 status 查询
  * - 结果写入 g_updateNeeded/g_target*，供 loop 决策
  */
 void prepareUpdateDecisionOnce() {
     Serial.println("\n========================================");
-    Serial.println("🔄 开始一次性更新判定（仅检查，不下载）...");
+    Serial.println("🔄 开始一次性更新判定...");
     Serial.println("========================================\n");
 
     // 防止被重复调用（例如某些异常路径下 setup/loop 误触发）
@@ -734,13 +2387,7 @@ void prepareUpdateDecisionOnce() {
     Serial.printf("📋 本地状态: claimed=%s, imageVersion=%d\n", 
                   deviceClaimed ? "是" : "否", localImageVersion);
     
-    // 3. 初始化Flash存储
-    if (!initFlashStorage()) {
-        Serial.println("❌ Flash初始化失败，本次唤醒直接进入Deep-sleep");
-        g_shouldEnterDeepSleep = true;
-        g_statusChecked = true;
-        return;
-    }
+    // 3. 帧分区不在这里查找：第一次写入下载数据时由 frameStoreInit 查找
     
     // 4. 设置默认EPD型号
     EPD_dispIndex = 0;
@@ -753,12 +2400,57 @@ void prepareUpdateDecisionOnce() {
         return;
     }
 
+    int conditional = -1;
+    bool conditionalTried = false;
+#if EPD_CONDITIONAL_UPDATE
+    // 已绑定且没有待续传的下载：先用一次条件 GET 检查更新（无更新时只需这一个请求）
+    if (deviceClaimed && g_resume.magic != EPD_RESUME_MAGIC) {
+        conditional = checkImageConditional();
+        conditionalTried = true;
+    }
+#endif
+
+#if EPD_PLAYLIST
+    // 已绑定：有播放列表时不更新单张图片，显示下一页后回睡
+    int versionBeforePlaylist = localImageVersion;
+    if (deviceClaimed && playlistRefresh(conditionalTried)) {
+        if (g_targetImagePrefetched) {
+            releaseDownloadSlot();
+            g_targetImagePrefetched = false;
+        }
+        g_playlistShow = true;
+        g_shouldEnterDeepSleep = true;
+        g_statusChecked = true;
+        return;
+    }
+    if (localImageVersion != versionBeforePlaylist && conditional == 0) {
+        // 刚退出播放列表，本地版本已清零：条件 GET 的 304 是按旧版本给的，改走 status 重新下载
+        conditional = -1;
+    }
+#endif
+
+#if EPD_CONDITIONAL_UPDATE
+    if (conditionalTried) {
+        if (conditional == 0) {
+            g_shouldEnterDeepSleep = true;
+            g_statusChecked = true;
+            return;
+        }
+        if (conditional == 1) {
+            g_updateNeeded = true;
+            g_statusChecked = true;
+            return;
+        }
+        Serial.println("ℹ️ 条件检查未得到结果，改为查询云端状态");
+    }
+#endif
+
     // 5. 查询云端状态
     Serial.println("\n📡 查询云端状态...");
     DeviceStatusResponse status = queryDeviceStatus();
     
     if (!status.success) {
-        Serial.printf("❌ 云端查询失败: %s\n", status.error.c_str());
+        Serial.printf("❌ 云端查询失败: %s\n", status.error);
         Serial.println("   直接进入Deep-sleep，下次唤醒再试");
         g_shouldEnterDeepSleep = true;
         g_statusChecked = true;
@@ -798,7 +2490,7 @@ void prepareUpdateDecisionOnce() {
                   status.imageVersion, localImageVersion);
     
     if (status.imageVersion > localImageVersion) {
-        if (status.imageUrl.length() == 0) {
+        if (status.imageUrl[0] == '\0') {
             Serial.println("⚠️  云端版本更新但未返回 imageUrl，本次跳过下载，直接Deep-sleep");
             g_shouldEnterDeepSleep = true;
         } else {
@@ -806,6 +2498,9 @@ void prepareUpdateDecisionOnce() {
             g_updateNeeded = true;
             g_targetImageVersion = status.imageVersion;
             g_targetImageUrl = status.imageUrl;
+            g_targetImageFormat = status.imageFormat;
+            g_targetImageSize = status.imageSize > 0 ? status.imageSize : expectedImageSize(status.imageFormat);
+            g_targetImageSha256 = status.imageSha256;
         }
     } else {
         Serial.println("✅ 图片已是最新版本，无需更新");
@@ -839,12 +2534,46 @@ void HTTP_UPDATE__setup() {
     g_deepSleepRequested = false;
     g_targetImageVersion = 0;
     g_targetImageUrl = "";
+    g_targetImageFormat = EPD_FORMAT_TEXT;
+    g_targetImageSize = 0;
+    g_targetImageSha256 = "";
+    g_targetImagePrefetched = false;
+    g_playlistShow = false;
+    g_playlistTag = "";
 
     // 注意：WiFi连接在 wifi_config.h 中完成（.ino 里保证已连上才会进入这里）
     // 本函数只做一次性判定，不做下载/刷新，不在这里立即 deep-sleep
     prepareUpdateDecisionOnce();
 }
 
+/**
+ * 下载 g_target* 指定的图片到帧槽；差分帧下载后打到基准帧上
+ * 差分失败时已放弃基准帧，重新查询一次 status，云端会改为下发完整帧
+ */
+static bool fetchTargetImage() {
+    if (!g_targetImagePrefetched &&
+        !downloadImageToFlash(g_targetImageUrl, g_targetImageSize, g_targetImageSha256)) {
+        return false;
+    }
+    if (g_targetImageFormat != EPD_FORMAT_DELTA || applyDeltaFrame()) {
+        return true;
+    }
+    
+    Serial.println("⚠️  差分更新失败，改为下载完整帧");
+    DeviceStatusResponse status = queryDeviceStatus();
+    if (!status.success || status.imageUrl[0] == '\0' || status.imageFormat == EPD_FORMAT_DELTA ||
+        status.imageVersion <= localImageVersion) {
+        return false;
+    }
+    g_targetImageVersion = status.imageVersion;
+    g_targetImageUrl = status.imageUrl;
+    g_targetImageFormat = status.imageFormat;
+    g_targetImageSize = status.imageSize > 0 ? status.imageSize : expectedImageSize(status.imageFormat);
+    g_targetImageSha256 = status.imageSha256;
+    g_targetImagePrefetched = false;
+    return downloadImageToFlash(g_targetImageUrl, g_targetImageSize, g_targetImageSha256);
+}
+
 /**
  * HTTP更新模式主循环（在loop中调用）
  * Deep-sleep架构下loop几乎不会被执行
@@ -867,11 +2596,35 @@ void HTTP_UPDATE__loop() {
         if (g_targetImageUrl.length() == 0 || g_targetImageVersion <= 0) {
             Serial.println("⚠️  更新参数不完整，跳过更新");
         } else {
-            if (downloadImageToFlash(g_targetImageUrl)) {
-                displayDownloadedImage();
-                saveImageVersion(g_targetImageVersion);
-                localImageVersion = g_targetImageVersion;
-                Serial.printf("✅ 已更新到版本: %d\n", localImageVersion);
+            bool updated = false;
+#if EPD_REFRESH_DEEP_SLEEP
+            EPD_7in3E_deferRefreshWait = true;
+#endif
+#if EPD_STREAM_TO_PANEL
+            if (!g_targetImagePrefetched && g_targetImageFormat != EPD_FORMAT_DELTA &&
+                g_targetImageSha256.length() == 64) {
+                updated = streamImageToPanel(g_targetImageUrl, g_targetImageSize, g_targetImageSha256);
+            } else
+#endif
+            if (fetchTargetImage()) {
+                updated = displayDownloadedImage(g_targetImageVersion);
+            }
+            if (updated) {
+                if (EPD_7in3E_refreshInFlight) {
+                    // 刷新由屏幕自行完成：版本号在唤醒确认刷新完成后再提交
+                    enterRefreshDeepSleep(g_targetImageVersion, EPD_REFRESH_FIRST_WAKE_MS);
+                }
+                if (g_frames.dirty) {
+                    // 帧槽表没写进 NVS：版本号不前进，下次唤醒重新下载，槽表随之再写一次
+                    Serial.println("⚠️  帧槽表未写入NVS，本次不提交版本号");
+                } else if (saveImageVersion(g_targetImageVersion)) {
+                    localImageVersion = g_targetImageVersion;
+                    g_pendingRefresh.magic = 0;  // 上次没提交成功的版本号已被取代
+                    Serial.printf("✅ 已更新到版本: %d\n", localImageVersion);
+                } else {
+                    // 版本号没写进 NVS：下次唤醒仍按旧版本检查，重新下载
+                    Serial.println("⚠️  本次不提交版本号");
+                }
             } else {
                 Serial.println("❌ 下载失败，本次不再重试，直接Deep-sleep");
             }
@@ -882,8 +2635,32 @@ void HTTP_UPDATE__loop() {
         g_shouldEnterDeepSleep = true;
     }
 
+#if EPD_PLAYLIST
+    // 2.5) 播放列表：显示下一页（清单已检查，各页已在帧分区中）
+    if (g_playlistShow) {
+        g_playlistShow = false;
+        g_updateAttempted = true;
+#if EPD_REFRESH_DEEP_SLEEP
+        EPD_7in3E_deferRefreshWait = true;
+#endif
+        if (playlistShowNext() && EPD_7in3E_refreshInFlight) {
+            enterRefreshDeepSleep(localImageVersion, EPD_REFRESH_FIRST_WAKE_MS);
+        }
+        g_shouldEnterDeepSleep = true;
+    }
+#endif
+
     // 3) 不需要更新：直接回睡（不做重复检查/重复动作）
+    //    已绑定但屏幕上不是当前帧（刚显示过设备码）时，先从帧分区重显，不用重新下载
     if (!g_updateNeeded) {
+        if (!g_updateAttempted && deviceClaimed && g_frames.current != FRAME_SLOT_NONE && g_frames.stale) {
+#if EPD_REFRESH_DEEP_SLEEP
+            EPD_7in3E_deferRefreshWait = true;
+#endif
+            if (redisplayCurrentFrame() && EPD_7in3E_refreshInFlight) {
+                enterRefreshDeepSleep(localImageVersion, EPD_REFRESH_FIRST_WAKE_MS);
+            }
+        }
         g_shouldEnterDeepSleep = true;
     }
 
@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file    bench_decode.cpp
+  * @brief   a~p 解码主机基准：逐字符分支解码 vs epd_decode.h 的 SWAR 解码
+  *          不参与固件编译（Arduino 只编译工程根目录的源文件）
+  *
+  *          g++ -O2 -std=c++17 tools/bench_decode.cpp -o bench_decode && ./bench_decode
+  ******************************************************************************
+  */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../epd_decode.h"
+
+// 一帧：800x480，4bit，每字节两个字符
+static const int FRAME_BYTES = 400 * 480;
+static const int ROUNDS = 50;
+
+// 原 EPD_7in3E_readTextRow 的逐字符解码（去掉文件读取部分）
+static int decodePerChar(const char *src, uint8_t *dst, int nBytes)
+{
+    int invalid = 0;
+    for (int i = 0; i < nBytes; i++) {
+        char c1 = src[2 * i];
+        char c2 = src[2 * i + 1];
+        if (c1 < 'a' || c1 > 'p' || c2 < 'a' || c2 > 'p') {
+            dst[i] = 0x11;
+            invalid++;
+            continue;
+        }
+        int low = (c1 - 'a') & 0x0F;
+        int high = (c2 - 'a') & 0x0F;
+        dst[i] = (uint8_t)((high << 4) | low);
+    }
+    return invalid;
+}
+
+template <typename F>
+static double timeDecode(F fn, const char *src, uint8_t *dst, int *invalid)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        *invalid = fn(src, dst, FRAME_BYTES);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(t1 - t0).count() / ROUNDS;
+}
+
+int main()
+{
+    // 4 字节对齐的字符缓冲区（与固件中的读取缓冲区一致）
+    std::vector<uint32_t> storage(FRAME_BYTES * 2 / 4);
+    char *chars = reinterpret_cast<char *>(storage.data());
+    srand(1);
+    for (int i = 0; i < FRAME_BYTES * 2; i++) {
+        chars[i] = (char)('a' + rand() % 16);
+    }
+    // 混入少量无效字符（含边界值和高位字节），验证两种实现结果一致
+    const char bad[] = { '`', 'q', 'A', '0', '\0', (char)0xE1, (char)0xF0, 'z' };
+    for (int i = 0; i < 64; i++) {
+        chars[rand() % (FRAME_BYTES * 2)] = bad[i % sizeof(bad)];
+    }
+
+    std::vector<uint8_t> a(FRAME_BYTES), b(FRAME_BYTES);
+    int invA = 0, invB = 0;
+    double usA = timeDecode(decodePerChar, chars, a.data(), &invA);
+    double usB = timeDecode(EPD_decodeChars, chars, b.data(), &invB);
+
+    if (invA != invB || memcmp(a.data(), b.data(), FRAME_BYTES) != 0) {
+        printf("MISMATCH: invalid %d vs %d\n", invA, invB);
+        return 1;
+    }
+
+    printf("frame: %d bytes, invalid pairs: %d\n", FRAME_BYTES, invA);
+    printf("per-char: %8.1f us/frame (%.2f ns/byte)\n", usA, usA * 1000.0 / FRAME_BYTES);
+    printf("swar    : %8.1f us/frame (%.2f ns/byte)\n", usB, usB * 1000.0 / FRAME_BYTES);
+    printf("speedup : %.2fx\n", usA / usB);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/**
+  ******************************************************************************
+  * @file    wake_timing.h
+  * @brief   唤醒耗时记录：把每次唤醒的清醒时间按阶段累计（esp_timer_get_time），
+  *          入睡前写入 RTC 内存中最近 WAKE_TIMING_HISTORY 次唤醒的环形记录，
+  *          下次联网时随条件 GET（请求头 X-EPD-Timing）或 status（timing 字段）上报，
+  *          云端按阶段统计 p50/p95（cloud_server/backend/app.py 中 WAKE_PHASES）
+  *
+  *          任一时刻只有一个当前阶段，切换时把经过的时间记到旧阶段，
+  *          所以各阶段之和就是本次唤醒的清醒时间；嵌套的阶段（如刷新前的屏幕初始化）
+  *          用 wakeTimingSwitch 的返回值切回原阶段
+  *
+  *          上报格式（紧凑文本）：
+  *            <bootId 十六进制>;<记录>;<记录>...
+  *            记录 = seq,唤醒原因,总毫秒,各阶段毫秒（按 WakePhase 顺序，逗号分隔）
+  ******************************************************************************
+  */
+
+#ifndef WAKE_TIMING_H
+#define WAKE_TIMING_H
+
+#include <Arduino.h>
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "device_state.h"
+
+#define WAKE_TIMING_MAGIC 0x57544D31UL  // "WTM1"
+
+// 阶段编号 WakePhase 和环形记录 g_wakeTiming 的定义在 device_state.h（与其他 RTC 状态一起带 CRC）
+
+static uint8_t g_wakePhase = WAKE_PHASE_BOOT;      // 当前阶段
+static int64_t g_wakePhaseSince = 0;               // 当前阶段的开始时间（esp_timer 从启动时为 0）
+static uint32_t g_wakePhaseUs[WAKE_PHASE_COUNT];   // 本次唤醒各阶段累计（微秒）
+static bool g_wakeTimingCommitted = false;
+static uint16_t g_wakeTimingFormatted = 0;         // 最近一次 wakeTimingFormat 写入的记录（按环形下标的位图）
+
+/**
+ * setup 开始时（deviceStateInit 之后）调用：记录无效（冷启动）时重新开始
+ */
+static inline void wakeTimingInit()
+{
+    if (g_wakeTiming.magic != WAKE_TIMING_MAGIC || g_wakeTiming.count > WAKE_TIMING_HISTORY ||
+        g_wakeTiming.head >= WAKE_TIMING_HISTORY) {
+        memset(&g_wakeTiming, 0, sizeof(g_wakeTiming));
+        g_wakeTiming.magic = WAKE_TIMING_MAGIC;
+        g_wakeTiming.bootId = esp_random();
+    }
+}
+
+/**
+ * 切换当前阶段
+ * @return 原来的阶段（嵌套使用时用它切回）
+ */
+static inline uint8_t wakeTimingSwitch(uint8_t phase)
+{
+    int64_t now = esp_timer_get_time();
+    uint8_t prev = g_wakePhase;
+    g_wakePhaseUs[prev] += (uint32_t)(now - g_wakePhaseSince);
+    g_wakePhaseSince = now;
+    g_wakePhase = phase;
+    return prev;
+}
+
+/**
+ * 入睡前调用：把本次唤醒写入环形记录（重复调用只记一次）
+ */
+static inline void wakeTimingCommit(uint8_t cause)
+{
+    if (g_wakeTimingCommitted) {
+        return;
+    }
+    g_wakeTimingCommitted = true;
+    wakeTimingSwitch(g_wakePhase);
+
+    WakeTimingRecord &r = g_wakeTiming.rec[g_wakeTiming.head];
+    r.seq = g_wakeTiming.nextSeq++;
+    r.cause = cause;
+    r.uploaded = 0;
+    r.totalMs = (uint32_t)(esp_timer_get_time() / 1000);
+    for (int i = 0; i < WAKE_PHASE_COUNT; i++) {
+        uint32_t ms = (g_wakePhaseUs[i] + 500) / 1000;
+        r.phaseMs[i] = ms > 0xFFFF ? 0xFFFF : (uint16_t)ms;
+    }
+    g_wakeTiming.head = (g_wakeTiming.head + 1) % WAKE_TIMING_HISTORY;
+    if (g_wakeTiming.count < WAKE_TIMING_HISTORY) {
+        g_wakeTiming.count++;
+    }
+    Serial.printf("   本次唤醒 %lu ms（启动 %u / WiFi %u / 检查 %u / 下载 %u / 解码 %u / 屏幕初始化 %u / 刷新 %u / 入睡 %u）\n",
+                  (unsigned long)r.totalMs, r.phaseMs[0], r.phaseMs[1], r.phaseMs[2], r.phaseMs[3],
+                  r.phaseMs[4], r.phaseMs[5], r.phaseMs[6], r.phaseMs[7]);
+}
+
+/**
+ * 把尚未上报的记录（从旧到新）按文件头的格式写入 buf，不分配内存
+ * @return 写入的长度（不含结尾 0）；没有待上报的记录时为 0；放不下的记录留到下次
+ */
+static inline int wakeTimingFormat(char *buf, size_t cap)
+{
+    int len = 0;
+    buf[0] = '\0';
+    g_wakeTimingFormatted = 0;
+    for (int i = 0; i < g_wakeTiming.count; i++) {
+        int idx = (g_wakeTiming.head + WAKE_TIMING_HISTORY - g_wakeTiming.count + i) % WAKE_TIMING_HISTORY;
+        const WakeTimingRecord &r = g_wakeTiming.rec[idx];
+        if (r.uploaded) {
+            continue;
+        }
+        char rec[96];
+        int n = 0;
+        if (len == 0) {
+            n += snprintf(rec + n, sizeof(rec) - n, "%lx", (unsigned long)g_wakeTiming.bootId);
+        }
+        n += snprintf(rec + n, sizeof(rec) - n, ";%u,%u,%lu", r.seq, r.cause, (unsigned long)r.totalMs);
+        for (int p = 0; p < WAKE_PHASE_COUNT; p++) {
+            n += snprintf(rec + n, sizeof(rec) - n, ",%u", r.phaseMs[p]);
+        }
+        if (len + n >= (int)cap) {
+            break;
+        }
+        memcpy(buf + len, rec, n + 1);
+        len += n;
+        g_wakeTimingFormatted |= (uint16_t)(1u << idx);
+    }
+    return len;
+}
+
+/**
+ * 尚未上报的记录（String 版，用于请求头/JSON）
+ */
+static inline String wakeTimingPending()
+{
+    char buf[WAKE_TIMING_HISTORY * 80];
+    wakeTimingFormat(buf, sizeof(buf));
+    return String(buf);
+}
+
+/**
+ * 云端已收到最近一次 wakeTimingFormat/wakeTimingPending 返回的记录（没放下的记录仍待上报）
+ */
+static inline void wakeTimingMarkUploaded()
+{
+    for (int i = 0; i < WAKE_TIMING_HISTORY; i++) {
+        if (g_wakeTimingFormatted & (1u << i)) {
+            g_wakeTiming.rec[i].uploaded = 1;
+        }
+    }
+    g_wakeTimingFormatted = 0;
+}
+
+#endif // WAKE_TIMING_H
@@ -15,40 +15,43 @@
 #include "esp_wifi.h"
 #include "esp_system.h"
 #include "esp_mac.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include "device_state.h"
 
 // 配网相关配置
 // 注意：DEVICE_ID_MODE 应该在 mqtt_config.h 中定义，这里使用默认值 2（后6位）
 #ifndef DEVICE_ID_MODE
 #define DEVICE_ID_MODE 2  // 设备码模式：1=前6位，2=后6位，其他=完整12位
 #endif
-#define CONFIG_NAMESPACE "wifi_cfg"   // Preferences命名空间
-#define CONFIG_SSID_KEY "ssid"        // WiFi SSID存储键
-#define CONFIG_PASSWORD_KEY "pwd"     // WiFi密码存储键
-#define CONFIG_CONFIGURED_KEY "cfg"   // 配网标志位存储键
+
+// 快速重连：记住上次成功连接的 BSSID、信道和 DHCP 分配的地址（RTC 内存 + NVS 备份），
+// 下次唤醒直接连到该信道/BSSID 并使用静态地址，省掉全信道扫描和 DHCP；失败再走完整流程
+#define WIFI_FAST_CONNECT 1
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 1500   // 快速重连（静态地址）等待时间，超时回退全扫描 + DHCP
+#define WIFI_FAST_DHCP_TIMEOUT_MS 5000      // 快速重连但走 DHCP（复用到上限/冷启动）时的等待时间，含 DHCP 往返
+#define WIFI_CONNECT_TIMEOUT_MS 10000       // 完整连接流程的等待时间
+#define WIFI_STATIC_IP_MAX_REUSE 16         // 静态地址连续复用次数上限，之后走一次 DHCP 刷新（避免租约过期后地址冲突）
+#define WIFI_FAST_CACHE_MAGIC 0x57464331UL  // "WFC1"
 
 // 全局变量
 WebServer server(80);
-extern Preferences preferences;  // 在Loader_esp32wf.ino中定义
 extern bool wifiConfigured;
 String savedSSID = "";
 String savedPassword = "";
 
+// 快速重连缓存 g_wifiCache（RTC 内存，NVS 中存一份）的定义在 device_state.h
+
 /**
- * 检查配网状态
+ * 检查配网状态（读 RTC 中的副本，冷启动时已从 NVS 载入）
  */
 bool checkWiFiConfigured() {
-    if (!preferences.begin(CONFIG_NAMESPACE, true)) {  // 只读模式
-        // NVS命名空间不存在（第一次使用），这是正常的
-        preferences.end();
+    if (!g_devState.wifiConfigured) {
         return false;
     }
-    bool configured = preferences.getBool(CONFIG_CONFIGURED_KEY, false);
-    if (configured) {
-        savedSSID = preferences.getString(CONFIG_SSID_KEY, "");
-        savedPassword = preferences.getString(CONFIG_PASSWORD_KEY, "");
-    }
-    preferences.end();
-    return configured && savedSSID.length() > 0;
+    savedSSID = g_devState.ssid;
+    savedPassword = g_devState.password;
+    return savedSSID.length() > 0;
 }
 
 /**
@@ -63,6 +66,13 @@ void saveWiFiConfig(String ssid, String password) {
     preferences.putString(CONFIG_PASSWORD_KEY, password);
     preferences.putBool(CONFIG_CONFIGURED_KEY, true);
     preferences.end();
+    // 配网后会 ESP.restart()，下次启动按冷启动从 NVS 载入；这里同步 RTC 副本以防调用方不重启
+    g_devState.wifiConfigured = ssid.length() > 0 && ssid.length() < sizeof(g_devState.ssid) &&
+                                password.length() < sizeof(g_devState.password);
+    if (g_devState.wifiConfigured) {
+        strcpy(g_devState.ssid, ssid.c_str());
+        strcpy(g_devState.password, password.c_str());
+    }
     Serial.println("✅ WiFi配置已保存");
 }
 
@@ -70,6 +80,10 @@ void saveWiFiConfig(String ssid, String password) {
  * 清除WiFi配置
  */
 void clearWiFiConfig() {
+    g_devState.wifiConfigured = 0;
+    memset(g_devState.ssid, 0, sizeof(g_devState.ssid));
+    memset(g_devState.password, 0, sizeof(g_devState.password));
+    g_wifiCache.magic = 0;
     if (!preferences.begin(CONFIG_NAMESPACE, false)) {
         // NVS命名空间不存在，无需清除
         preferences.end();
@@ -77,6 +91,7 @@ void clearWiFiConfig() {
     }
     preferences.remove(CONFIG_SSID_KEY);
     preferences.remove(CONFIG_PASSWORD_KEY);
+    preferences.remove(CONFIG_FAST_KEY);
     preferences.putBool(CONFIG_CONFIGURED_KEY, false);
     preferences.end();
     Serial.println("🗑️  WiFi配置已清除");
@@ -300,8 +315,72 @@ void initConfigServer() {
     Serial.println("✅ Web配网服务器已启动");
 }
 
+/**
+ * 当前 SSID + 密码的 CRC（快速重连缓存与配网信息对应）
+ */
+static uint32_t wifiCredCrc() {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)savedSSID.c_str(), savedSSID.length() + 1);
+    return esp_rom_crc32_le(crc, (const uint8_t *)savedPassword.c_str(), savedPassword.length());
+}
+
+/**
+ * 取得可用的快速重连缓存（冷启动时 deviceStateInit 已从 NVS 恢复）
+ * @return 缓存有效且属于当前配网信息
+ */
+static bool loadWiFiFastCache() {
+    return g_wifiCache.magic == WIFI_FAST_CACHE_MAGIC && g_wifiCache.credCrc == wifiCredCrc() &&
+           g_wifiCache.channel > 0;
+}
+
+/**
+ * 连接成功后记下 BSSID/信道/地址；NVS 只在 AP 或地址变化时写入，避免每次唤醒都写 Flash
+ * @param viaDhcp 本次地址来自 DHCP（重新开始计复用次数）
+ */
+static void saveWiFiFastCache(bool viaDhcp) {
+    WiFiFastCache c = {};
+    c.magic = WIFI_FAST_CACHE_MAGIC;
+    c.credCrc = wifiCredCrc();
+    memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+    c.channel = (uint8_t)WiFi.channel();
+    c.ip = (uint32_t)WiFi.localIP();
+    c.gateway = (uint32_t)WiFi.gatewayIP();
+    c.subnet = (uint32_t)WiFi.subnetMask();
+    c.dns = (uint32_t)WiFi.dnsIP(0);
+    c.reuse = viaDhcp ? 0 : g_wifiCache.reuse + 1;
+    
+    bool changed = g_wifiCache.magic != c.magic || g_wifiCache.credCrc != c.credCrc ||
+                   memcmp(g_wifiCache.bssid, c.bssid, sizeof(c.bssid)) != 0 || g_wifiCache.channel != c.channel ||
+                   g_wifiCache.ip != c.ip || g_wifiCache.gateway != c.gateway ||
+                   g_wifiCache.subnet != c.subnet || g_wifiCache.dns != c.dns;
+    g_wifiCache = c;
+    if (changed && preferences.begin(CONFIG_NAMESPACE, false)) {
+        WiFiFastCache stored = c;
+        stored.reuse = 0;
+        preferences.putBytes(CONFIG_FAST_KEY, &stored, sizeof(stored));
+        preferences.end();
+    }
+}
+
+/**
+ * 等待连接完成
+ * @return 是否在 timeoutMs 内连上
+ */
+static bool waitWiFiConnected(unsigned long timeoutMs) {
+    unsigned long start = millis();
+    unsigned long lastDot = start;
+    while (WiFi.status() != WL_CONNECTED && millis() - start < timeoutMs) {
+        delay(10);
+        if (millis() - lastDot >= 500) {
+            lastDot = millis();
+            Serial.print(".");
+        }
+    }
+    return WiFi.status() == WL_CONNECTED;
+}
+
 /**
  * 连接WiFi（使用保存的配置）
+ * 有快速重连缓存时先直连上次的信道/BSSID（地址复用未超过上限时同时用静态地址），失败再全扫描 + DHCP
  */
 bool connectWiFi() {
     if (!checkWiFiConfigured()) {
@@ -313,20 +392,48 @@ bool connectWiFi() {
     Serial.printf("   SSID: %s\n", savedSSID.c_str());
     
     WiFi.mode(WIFI_STA);
-    WiFi.begin(savedSSID.c_str(), savedPassword.c_str());
+    unsigned long startMs = millis();
+    bool connected = false;
+    bool viaDhcp = true;
+    
+#if WIFI_FAST_CONNECT
+    if (loadWiFiFastCache()) {
+        bool staticIp = g_wifiCache.ip != 0 && g_wifiCache.reuse < WIFI_STATIC_IP_MAX_REUSE;
+        Serial.printf("   快速重连: 信道 %d，BSSID %02X:%02X:%02X:%02X:%02X:%02X，%s\n", g_wifiCache.channel,
+                      g_wifiCache.bssid[0], g_wifiCache.bssid[1], g_wifiCache.bssid[2],
+                      g_wifiCache.bssid[3], g_wifiCache.bssid[4], g_wifiCache.bssid[5],
+                      staticIp ? "静态地址" : "DHCP");
+        if (staticIp) {
+            WiFi.config(IPAddress(g_wifiCache.ip), IPAddress(g_wifiCache.gateway),
+                        IPAddress(g_wifiCache.subnet), IPAddress(g_wifiCache.dns));
+        }
+        WiFi.begin(savedSSID.c_str(), savedPassword.c_str(), g_wifiCache.channel, g_wifiCache.bssid);
+        connected = waitWiFiConnected(staticIp ? WIFI_FAST_CONNECT_TIMEOUT_MS : WIFI_FAST_DHCP_TIMEOUT_MS);
+        viaDhcp = !staticIp;
+        if (!connected) {
+            // AP 换了信道/BSSID 或地址不可用：断开，恢复 DHCP，走完整流程
+            Serial.println("\n   快速重连失败，改为全信道扫描 + DHCP");
+            WiFi.disconnect();
+            WiFi.config(IPAddress(), IPAddress(), IPAddress());
+            g_wifiCache.magic = 0;
+            viaDhcp = true;
+        }
+    }
+#endif
     
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
+    if (!connected) {
+        WiFi.begin(savedSSID.c_str(), savedPassword.c_str());
+        connected = waitWiFiConnected(WIFI_CONNECT_TIMEOUT_MS);
     }
     
-    if (WiFi.status() == WL_CONNECTED) {
+    if (connected) {
         Serial.println("");
-        Serial.println("✅ WiFi连接成功");
+        Serial.printf("✅ WiFi连接成功（耗时 %lu ms）\n", millis() - startMs);
         Serial.print("   IP地址: ");
         Serial.println(WiFi.localIP());
+#if WIFI_FAST_CONNECT
+        saveWiFiFastCache(viaDhcp);
+#endif
         return true;
     } else {
         Serial.println("");